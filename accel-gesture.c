@@ -0,0 +1,163 @@
+// SPDX-License-Identifier: MIT
+// Copyright (C) 2026 Bardia Moshiri <bardia@furilabs.com>
+
+#include <math.h>
+#include <string.h>
+#include "accel-gesture.h"
+
+#define ACCEL_RING_MASK (ACCEL_RING_SIZE - 1)
+#define ACCEL_LOWPASS_ALPHA 0.5f
+#define ACCEL_PICKUP_MIN_SAMPLES 3
+// How far below the raise line the window has to dip so jitter around the
+// threshold angle does not count as a tilt
+#define ACCEL_RAISE_MARGIN (0.05f * ACCEL_STANDARD_GRAVITY * ACCEL_STANDARD_GRAVITY)
+
+_Static_assert((ACCEL_RING_SIZE & ACCEL_RING_MASK) == 0, "ACCEL_RING_SIZE must be a power of two");
+
+static float
+window_min(const float *restrict v, unsigned int n)
+{
+    float m = INFINITY;
+    for (unsigned int i = 0; i < n; i++)
+        m = v[i] < m ? v[i] : m;
+    return m;
+}
+
+static unsigned int
+window_count_above(const float *restrict v, unsigned int n, float threshold)
+{
+    unsigned int c = 0;
+    for (unsigned int i = 0; i < n; i++)
+        c += v[i] > threshold;
+    return c;
+}
+
+// The live window is [head, head + count) and may wrap, so every kernel runs
+// over at most two contiguous runs of the ring
+static void
+window_runs(const struct accel_gesture *ag, unsigned int *first, unsigned int *second)
+{
+    unsigned int to_end = ACCEL_RING_SIZE - ag->head;
+    *first = ag->count < to_end ? ag->count : to_end;
+    *second = ag->count - *first;
+}
+
+void
+accel_gesture_init(struct accel_gesture *ag, const struct accel_gesture_config *config)
+{
+    float s = sinf((float)config->tilt_angle * (float)M_PI / 180.0f);
+
+    memset(ag, 0, sizeof(*ag));
+    ag->config = *config;
+    ag->raise_ratio_sq = s * s;
+    ag->pickup_threshold = (float)config->pickup_threshold;
+    ag->still_threshold = (float)config->pickup_threshold / 2.0f;
+}
+
+void
+accel_gesture_reset(struct accel_gesture *ag)
+{
+    ag->primed = 0;
+    ag->head = 0;
+    ag->count = 0;
+}
+
+static void
+push_sample(struct accel_gesture *ag, const struct accel_sample *sample)
+{
+    float x = (float)sample->x, y = (float)sample->y, z = (float)sample->z;
+    unsigned int idx;
+
+    if (!ag->primed) {
+        ag->lp_x = x;
+        ag->lp_y = y;
+        ag->lp_z = z;
+        ag->primed = 1;
+    } else {
+        ag->lp_x += ACCEL_LOWPASS_ALPHA * (x - ag->lp_x);
+        ag->lp_y += ACCEL_LOWPASS_ALPHA * (y - ag->lp_y);
+        ag->lp_z += ACCEL_LOWPASS_ALPHA * (z - ag->lp_z);
+    }
+
+    if (ag->count == ACCEL_RING_SIZE) {
+        ag->head = (ag->head + 1) & ACCEL_RING_MASK;
+        ag->count--;
+    }
+
+    idx = (ag->head + ag->count) & ACCEL_RING_MASK;
+    ag->count++;
+
+    float lp_mag_sq = ag->lp_x * ag->lp_x + ag->lp_y * ag->lp_y + ag->lp_z * ag->lp_z;
+    ag->ts[idx] = sample->timestamp;
+    ag->raise[idx] = ag->lp_y * fabsf(ag->lp_y) - ag->raise_ratio_sq * lp_mag_sq;
+    ag->motion[idx] = fabsf(sqrtf(x * x + y * y + z * z) - ACCEL_STANDARD_GRAVITY);
+    ag->face[idx] = ag->lp_z;
+
+    uint64_t window_us = (uint64_t)ag->config.window_ms * 1000;
+    while (ag->count > 1 && ag->ts[ag->head] + window_us < sample->timestamp) {
+        ag->head = (ag->head + 1) & ACCEL_RING_MASK;
+        ag->count--;
+    }
+}
+
+static enum accel_gesture_type
+detect(const struct accel_gesture *ag)
+{
+    unsigned int first, second;
+    unsigned int last = (ag->head + ag->count - 1) & ACCEL_RING_MASK;
+
+    // Both gestures end with the device held still and facing the user
+    if (ag->count < 2 || ag->motion[last] > ag->still_threshold || ag->face[last] < 0)
+        return ACCEL_GESTURE_NONE;
+
+    window_runs(ag, &first, &second);
+
+    if (ag->raise[last] >= 0) {
+        float lowest = window_min(&ag->raise[ag->head], first);
+        float wrapped = window_min(ag->raise, second);
+        if ((wrapped < lowest ? wrapped : lowest) < -ACCEL_RAISE_MARGIN)
+            return ACCEL_GESTURE_TILT;
+    }
+
+    unsigned int moving = window_count_above(&ag->motion[ag->head], first, ag->pickup_threshold) +
+                          window_count_above(ag->motion, second, ag->pickup_threshold);
+    if (moving >= ACCEL_PICKUP_MIN_SAMPLES)
+        return ACCEL_GESTURE_PICKUP;
+
+    return ACCEL_GESTURE_NONE;
+}
+
+enum accel_gesture_type
+accel_gesture_feed(struct accel_gesture *ag, const struct accel_sample *samples, size_t n_samples)
+{
+    for (size_t i = 0; i < n_samples; i++) {
+        unsigned int last = (ag->head + ag->count - 1) & ACCEL_RING_MASK;
+
+        // Polling can hand back the same reading twice, skip it
+        if (ag->count > 0 && samples[i].timestamp <= ag->ts[last])
+            continue;
+
+        push_sample(ag, &samples[i]);
+
+        enum accel_gesture_type type = detect(ag);
+        if (type != ACCEL_GESTURE_NONE) {
+            accel_gesture_reset(ag);
+            return type;
+        }
+    }
+
+    return ACCEL_GESTURE_NONE;
+}
+
+const char *
+accel_gesture_name(enum accel_gesture_type type)
+{
+    switch (type) {
+    case ACCEL_GESTURE_TILT:
+        return "tilt";
+    case ACCEL_GESTURE_PICKUP:
+        return "pickup";
+    default:
+        return "none";
+    }
+}
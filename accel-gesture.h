@@ -0,0 +1,57 @@
+// SPDX-License-Identifier: MIT
+// Copyright (C) 2026 Bardia Moshiri <bardia@furilabs.com>
+
+#ifndef ACCEL_GESTURE_H
+#define ACCEL_GESTURE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Must be a power of two, the ring index is masked rather than wrapped
+#define ACCEL_RING_SIZE 64
+#define ACCEL_STANDARD_GRAVITY 1000 // mG
+
+enum accel_gesture_type {
+    ACCEL_GESTURE_NONE = 0,
+    ACCEL_GESTURE_TILT = 1,
+    ACCEL_GESTURE_PICKUP = 2,
+};
+
+// One sensorfw accelerometer reading, laid out like its "(tiii)" D-Bus value
+struct accel_sample {
+    uint64_t timestamp; // us
+    int32_t x, y, z;    // mG
+};
+
+struct accel_gesture_config {
+    int32_t tilt_angle;       // degrees above flat the device has to be raised
+    int32_t pickup_threshold; // mG deviation from 1 g counted as motion
+    uint32_t window_ms;       // how far back a gesture may start
+};
+
+struct accel_gesture {
+    struct accel_gesture_config config;
+
+    // Precomputed from config so the kernels stay multiply/compare only
+    float raise_ratio_sq;
+    float pickup_threshold;
+    float still_threshold;
+
+    float lp_x, lp_y, lp_z;
+    int primed;
+
+    // Structure of arrays so the window kernels vectorize
+    uint64_t ts[ACCEL_RING_SIZE];
+    float raise[ACCEL_RING_SIZE];  // y|y| - sin²(angle)·|a|², >= 0 when raised
+    float motion[ACCEL_RING_SIZE]; // ||a| - 1 g| of the unfiltered sample
+    float face[ACCEL_RING_SIZE];   // filtered z, < 0 when facing down
+    unsigned int head;
+    unsigned int count;
+};
+
+void accel_gesture_init(struct accel_gesture *ag, const struct accel_gesture_config *config);
+void accel_gesture_reset(struct accel_gesture *ag);
+enum accel_gesture_type accel_gesture_feed(struct accel_gesture *ag, const struct accel_sample *samples, size_t n_samples);
+const char *accel_gesture_name(enum accel_gesture_type type);
+
+#endif // ACCEL_GESTURE_H
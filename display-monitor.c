@@ -0,0 +1,160 @@
+// SPDX-License-Identifier: MIT
+// Copyright (C) 2026 Bardia Moshiri <bardia@furilabs.com>
+
+#include "display-monitor.h"
+
+// PowerSaveMode is 0 for on, 1 to 3 for the DPMS standby, suspend and off
+// levels, -1 when unknown. Anything but on counts as dark.
+static void
+apply_mode(DisplayMonitor *monitor, gint32 mode)
+{
+    gboolean off = (mode > 0);
+
+    if (off == monitor->off)
+        return;
+
+    monitor->off = off;
+    g_debug("Outputs %s", off ? "off" : "on");
+
+    if (monitor->changed)
+        monitor->changed(monitor->user_data);
+}
+
+static void
+on_properties_changed(GDBusConnection *connection,
+                      const gchar *sender_name,
+                      const gchar *object_path,
+                      const gchar *interface_name,
+                      const gchar *signal_name,
+                      GVariant *parameters,
+                      gpointer user_data)
+{
+    DisplayMonitor *monitor = user_data;
+    const gchar *property_interface;
+    GVariant *changed_properties;
+    GVariant *invalidated_properties;
+    gint32 mode;
+
+    g_variant_get(parameters, "(&s@a{sv}@as)",
+                  &property_interface,
+                  &changed_properties,
+                  &invalidated_properties);
+
+    if (monitor->available && g_variant_lookup(changed_properties, "PowerSaveMode", "i", &mode))
+        apply_mode(monitor, mode);
+
+    g_variant_unref(changed_properties);
+    g_variant_unref(invalidated_properties);
+}
+
+static void
+on_get_ready(GObject *source,
+             GAsyncResult *res,
+             gpointer user_data)
+{
+    GError *error = NULL;
+    GVariant *result = g_dbus_connection_call_finish(G_DBUS_CONNECTION(source), res, &error);
+    GVariant *value;
+
+    // Cancelled means the monitor is being cleared, leave it alone
+    if (!result) {
+        if (!g_error_matches(error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+            g_debug("Failed to read PowerSaveMode: %s", error->message);
+        g_error_free(error);
+        return;
+    }
+
+    DisplayMonitor *monitor = user_data;
+
+    g_variant_get(result, "(v)", &value);
+    monitor->available = TRUE;
+    if (g_variant_is_of_type(value, G_VARIANT_TYPE_INT32))
+        apply_mode(monitor, g_variant_get_int32(value));
+
+    g_variant_unref(value);
+    g_variant_unref(result);
+}
+
+static void
+on_compositor_appeared(GDBusConnection *connection,
+                       const gchar *name,
+                       const gchar *name_owner,
+                       gpointer user_data)
+{
+    DisplayMonitor *monitor = user_data;
+
+    g_dbus_connection_call(monitor->connection,
+                           DISPLAY_MONITOR_NAME,
+                           DISPLAY_MONITOR_PATH,
+                           "org.freedesktop.DBus.Properties",
+                           "Get",
+                           g_variant_new("(ss)", DISPLAY_MONITOR_NAME, "PowerSaveMode"),
+                           G_VARIANT_TYPE("(v)"),
+                           G_DBUS_CALL_FLAGS_NO_AUTO_START,
+                           -1,
+                           monitor->cancellable,
+                           on_get_ready,
+                           monitor);
+}
+
+// The outputs are left as they were, IdleHint carries on arming without us
+static void
+on_compositor_vanished(GDBusConnection *connection,
+                       const gchar *name,
+                       gpointer user_data)
+{
+    DisplayMonitor *monitor = user_data;
+
+    monitor->available = FALSE;
+    monitor->off = FALSE;
+}
+
+// Signal driven only, the same way as PowerMonitor
+void
+display_monitor_init(DisplayMonitor *monitor, GDBusConnection *connection,
+                     DisplayMonitorChangedFunc changed, gpointer user_data)
+{
+    monitor->connection = g_object_ref(connection);
+    monitor->changed = changed;
+    monitor->user_data = user_data;
+    monitor->cancellable = g_cancellable_new();
+
+    monitor->subscription_id = g_dbus_connection_signal_subscribe(connection,
+                                                                  DISPLAY_MONITOR_NAME,
+                                                                  "org.freedesktop.DBus.Properties",
+                                                                  "PropertiesChanged",
+                                                                  DISPLAY_MONITOR_PATH,
+                                                                  DISPLAY_MONITOR_NAME,
+                                                                  G_DBUS_SIGNAL_FLAGS_NONE,
+                                                                  on_properties_changed,
+                                                                  monitor,
+                                                                  NULL);
+    monitor->watch_id = g_bus_watch_name_on_connection(connection,
+                                                       DISPLAY_MONITOR_NAME,
+                                                       G_BUS_NAME_WATCHER_FLAGS_NONE,
+                                                       on_compositor_appeared,
+                                                       on_compositor_vanished,
+                                                       monitor,
+                                                       NULL);
+}
+
+void
+display_monitor_clear(DisplayMonitor *monitor)
+{
+    if (monitor->cancellable) {
+        g_cancellable_cancel(monitor->cancellable);
+        g_object_unref(monitor->cancellable);
+    }
+    if (monitor->watch_id > 0)
+        g_bus_unwatch_name(monitor->watch_id);
+    if (monitor->subscription_id > 0)
+        g_dbus_connection_signal_unsubscribe(monitor->connection, monitor->subscription_id);
+    if (monitor->connection)
+        g_object_unref(monitor->connection);
+
+    monitor->cancellable = NULL;
+    monitor->watch_id = 0;
+    monitor->subscription_id = 0;
+    monitor->connection = NULL;
+    monitor->available = FALSE;
+}
@@ -0,0 +1,32 @@
+// SPDX-License-Identifier: MIT
+// Copyright (C) 2026 Bardia Moshiri <bardia@furilabs.com>
+
+#ifndef DISPLAY_MONITOR_H
+#define DISPLAY_MONITOR_H
+
+#include <glib.h>
+#include <gio/gio.h>
+
+// Phosh and Mutter both publish the output power state here on the session bus
+#define DISPLAY_MONITOR_NAME "org.gnome.Mutter.DisplayConfig"
+#define DISPLAY_MONITOR_PATH "/org/gnome/Mutter/DisplayConfig"
+
+// Called when the outputs turn off or on, not when the compositor comes and goes
+typedef void (*DisplayMonitorChangedFunc)(gpointer user_data);
+
+typedef struct {
+    GDBusConnection *connection;
+    guint watch_id;
+    guint subscription_id;
+    GCancellable *cancellable;
+    gboolean available; // FALSE until the compositor has answered, and after it leaves
+    gboolean off;
+    DisplayMonitorChangedFunc changed;
+    gpointer user_data;
+} DisplayMonitor;
+
+void display_monitor_init(DisplayMonitor *monitor, GDBusConnection *connection,
+                          DisplayMonitorChangedFunc changed, gpointer user_data);
+void display_monitor_clear(DisplayMonitor *monitor);
+
+#endif // DISPLAY_MONITOR_H
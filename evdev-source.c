@@ -0,0 +1,231 @@
+// SPDX-License-Identifier: MIT
+// Copyright (C) 2026 Bardia Moshiri <bardia@furilabs.com>
+
+#include <glib-unix.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <linux/input.h>
+#include "evdev-source.h"
+
+#define INPUT_DIR "/dev/input"
+#define EVENT_BATCH 64
+
+#define BITS_PER_LONG (sizeof(unsigned long) * 8)
+#define NLONGS(n) (((n) + BITS_PER_LONG - 1) / BITS_PER_LONG)
+
+// Keys touch panels and wake-capable buttons report for screen-off gestures
+static const guint16 wake_keys[] = {
+    KEY_WAKEUP,
+};
+
+static gboolean
+is_wake_key(guint16 code)
+{
+    for (gsize i = 0; i < G_N_ELEMENTS(wake_keys); i++)
+        if (wake_keys[i] == code)
+            return TRUE;
+
+    return FALSE;
+}
+
+static gboolean
+test_bit(const unsigned long *bits, guint bit)
+{
+    return bits[bit / BITS_PER_LONG] & (1UL << (bit % BITS_PER_LONG));
+}
+
+// 0 for devices without a wake key. Touch panels rank above buttons, their
+// wake keys are the screen-off gestures this source is for.
+static int
+device_rank(int fd)
+{
+    unsigned long keys[NLONGS(KEY_CNT)] = {0};
+    unsigned long abs[NLONGS(ABS_CNT)] = {0};
+    gboolean wake_key = FALSE;
+
+    if (ioctl(fd, EVIOCGBIT(EV_KEY, sizeof(keys)), keys) < 0)
+        return 0;
+
+    for (gsize i = 0; i < G_N_ELEMENTS(wake_keys); i++)
+        wake_key |= test_bit(keys, wake_keys[i]);
+    if (!wake_key)
+        return 0;
+
+    if (ioctl(fd, EVIOCGBIT(EV_ABS, sizeof(abs)), abs) >= 0 && test_bit(abs, ABS_MT_POSITION_X))
+        return 2;
+
+    return 1;
+}
+
+// event2 before event10
+static gint
+compare_event_nodes(gconstpointer a, gconstpointer b)
+{
+    const gchar *name_a = *(const gchar * const *)a;
+    const gchar *name_b = *(const gchar * const *)b;
+    guint64 node_a = g_ascii_strtoull(name_a + strlen("event"), NULL, 10);
+    guint64 node_b = g_ascii_strtoull(name_b + strlen("event"), NULL, 10);
+
+    return node_a < node_b ? -1 : node_a > node_b;
+}
+
+static GPtrArray *
+list_event_nodes(void)
+{
+    GDir *dir = g_dir_open(INPUT_DIR, 0, NULL);
+    GPtrArray *nodes;
+    const gchar *entry;
+
+    if (!dir)
+        return NULL;
+
+    nodes = g_ptr_array_new_with_free_func(g_free);
+    while ((entry = g_dir_read_name(dir)))
+        if (g_str_has_prefix(entry, "event"))
+            g_ptr_array_add(nodes, g_strdup(entry));
+    g_dir_close(dir);
+
+    g_ptr_array_sort(nodes, compare_event_nodes);
+    return nodes;
+}
+
+// Drains everything the kernel has queued in as few reads as possible, the
+// source only wakes the main loop when the device has something to report
+static gboolean
+on_evdev_readable(gint fd, GIOCondition condition, gpointer user_data)
+{
+    EvdevSource *src = user_data;
+    struct input_event events[EVENT_BATCH];
+
+    if (condition & (G_IO_HUP | G_IO_ERR | G_IO_NVAL)) {
+        g_warning("Input device %s went away", src->path);
+        goto gone;
+    }
+
+    for (;;) {
+        ssize_t n = read(fd, events, sizeof(events));
+        if (n < 0) {
+            if (errno == EINTR)
+                continue;
+            if (errno == EAGAIN)
+                break;
+            g_warning("Failed to read %s: %s", src->path, g_strerror(errno));
+            goto gone;
+        }
+
+        gsize count = n / sizeof(struct input_event);
+        for (gsize i = 0; i < count; i++) {
+            const struct input_event *ev = &events[i];
+            if (ev->type != EV_KEY || ev->value != 1 || !is_wake_key(ev->code))
+                continue;
+
+            guint64 timestamp = (guint64)ev->input_event_sec * G_USEC_PER_SEC + ev->input_event_usec;
+            src->callback(ev->code, timestamp, src->user_data);
+        }
+
+        if (count < EVENT_BATCH)
+            break;
+    }
+
+    return G_SOURCE_CONTINUE;
+
+gone:
+    src->source_id = 0;
+    close(src->fd);
+    src->fd = -1;
+    return G_SOURCE_REMOVE;
+}
+
+void
+evdev_source_init(EvdevSource *src)
+{
+    memset(src, 0, sizeof(*src));
+    src->fd = -1;
+}
+
+// With a device name only that device is used. Otherwise the best ranked
+// device that can report a wake key wins, the lowest event node among equals,
+// so the choice does not depend on directory order. skip_name keeps the
+// daemon from listening to the uinput device it injects wakes through.
+gboolean
+evdev_source_open(EvdevSource *src, const gchar *device_name, const gchar *skip_name,
+                  EvdevWakeFunc callback, gpointer user_data)
+{
+    GPtrArray *nodes;
+    char name[256];
+    gchar *best_name = NULL;
+    int best_rank = 0;
+    int clock = CLOCK_MONOTONIC;
+
+    if (src->fd >= 0)
+        return TRUE;
+
+    nodes = list_event_nodes();
+    if (!nodes)
+        return FALSE;
+
+    for (guint i = 0; i < nodes->len; i++) {
+        gchar *path = g_build_filename(INPUT_DIR, g_ptr_array_index(nodes, i), NULL);
+        int fd = open(path, O_RDONLY | O_NONBLOCK | O_CLOEXEC);
+        if (fd < 0) {
+            g_free(path);
+            continue;
+        }
+
+        memset(name, 0, sizeof(name));
+        ioctl(fd, EVIOCGNAME(sizeof(name) - 1), name);
+
+        int rank = 0;
+        if ((!device_name || strcmp(name, device_name) == 0) &&
+            (!skip_name || strcmp(name, skip_name) != 0))
+            rank = device_rank(fd);
+
+        if (rank <= best_rank) {
+            close(fd);
+            g_free(path);
+            continue;
+        }
+
+        if (src->fd >= 0)
+            close(src->fd);
+        g_free(src->path);
+        g_free(best_name);
+        src->fd = fd;
+        src->path = path;
+        best_name = g_strdup(name);
+        best_rank = rank;
+    }
+
+    g_ptr_array_unref(nodes);
+
+    if (src->fd < 0)
+        return FALSE;
+
+    if (ioctl(src->fd, EVIOCSCLOCKID, &clock) < 0)
+        g_debug("Failed to switch %s to the monotonic clock", src->path);
+
+    g_debug("Listening for wake keys on %s (%s)", src->path, best_name);
+    g_free(best_name);
+
+    src->callback = callback;
+    src->user_data = user_data;
+    src->source_id = g_unix_fd_add(src->fd, G_IO_IN | G_IO_HUP | G_IO_ERR, on_evdev_readable, src);
+
+    return TRUE;
+}
+
+void
+evdev_source_close(EvdevSource *src)
+{
+    if (src->source_id > 0)
+        g_source_remove(src->source_id);
+    if (src->fd >= 0)
+        close(src->fd);
+    g_free(src->path);
+
+    evdev_source_init(src);
+}
@@ -0,0 +1,26 @@
+// SPDX-License-Identifier: MIT
+// Copyright (C) 2026 Bardia Moshiri <bardia@furilabs.com>
+
+#ifndef EVDEV_SOURCE_H
+#define EVDEV_SOURCE_H
+
+#include <glib.h>
+
+// code is the evdev key code, timestamp is CLOCK_MONOTONIC in us so it lines
+// up with sensorfw timestamps
+typedef void (*EvdevWakeFunc)(guint16 code, guint64 timestamp, gpointer user_data);
+
+typedef struct {
+    gint fd;
+    guint source_id;
+    gchar *path;
+    EvdevWakeFunc callback;
+    gpointer user_data;
+} EvdevSource;
+
+void evdev_source_init(EvdevSource *src);
+gboolean evdev_source_open(EvdevSource *src, const gchar *device_name, const gchar *skip_name,
+                           EvdevWakeFunc callback, gpointer user_data);
+void evdev_source_close(EvdevSource *src);
+
+#endif // EVDEV_SOURCE_H
@@ -0,0 +1,265 @@
+// SPDX-License-Identifier: MIT
+// Copyright (C) 2026 Bardia Moshiri <bardia@furilabs.com>
+
+#include <errno.h>
+#include "gesture-hub.h"
+#include "trace.h"
+
+static const gchar introspection_xml[] =
+    "<node>"
+    "  <interface name='" GESTURE_HUB_INTERFACE "'>"
+    "    <method name='Subscribe'/>"
+    "    <method name='Unsubscribe'/>"
+    "    <method name='DumpLog'>"
+    "      <arg type='s' name='path' direction='out'/>"
+    "    </method>"
+    "    <signal name='Gesture'>"
+    "      <arg type='s' name='kind'/>"
+    "      <arg type='t' name='timestamp'/>"
+    "    </signal>"
+    "    <property name='Subscribers' type='u' access='read'/>"
+    "  </interface>"
+    "</node>";
+
+// One entry per client unique name, a client may subscribe more than once
+typedef struct {
+    guint refs;
+    guint watch_id;
+} Subscriber;
+
+static void
+subscriber_free(gpointer data)
+{
+    Subscriber *subscriber = data;
+
+    g_bus_unwatch_name(subscriber->watch_id);
+    g_free(subscriber);
+}
+
+static void
+notify_changed(GestureHub *hub)
+{
+    guint count = g_hash_table_size(hub->subscribers);
+
+    g_debug("Gesture hub has %u subscribers", count);
+    if (hub->changed)
+        hub->changed(count, hub->user_data);
+}
+
+// A client that exits or crashes without unsubscribing must not keep the
+// sensors powered
+static void
+on_subscriber_vanished(GDBusConnection *connection,
+                       const gchar *name,
+                       gpointer user_data)
+{
+    GestureHub *hub = user_data;
+
+    if (g_hash_table_remove(hub->subscribers, name))
+        notify_changed(hub);
+}
+
+static void
+subscribe(GestureHub *hub, const gchar *sender)
+{
+    Subscriber *subscriber = g_hash_table_lookup(hub->subscribers, sender);
+
+    if (subscriber) {
+        subscriber->refs++;
+        return;
+    }
+
+    subscriber = g_new0(Subscriber, 1);
+    subscriber->refs = 1;
+    subscriber->watch_id = g_bus_watch_name_on_connection(hub->connection,
+                                                          sender,
+                                                          G_BUS_NAME_WATCHER_FLAGS_NONE,
+                                                          NULL,
+                                                          on_subscriber_vanished,
+                                                          hub,
+                                                          NULL);
+    g_hash_table_insert(hub->subscribers, g_strdup(sender), subscriber);
+    notify_changed(hub);
+}
+
+static gboolean
+unsubscribe(GestureHub *hub, const gchar *sender)
+{
+    Subscriber *subscriber = g_hash_table_lookup(hub->subscribers, sender);
+
+    if (!subscriber)
+        return FALSE;
+
+    if (--subscriber->refs == 0) {
+        g_hash_table_remove(hub->subscribers, sender);
+        notify_changed(hub);
+    }
+
+    return TRUE;
+}
+
+// Same dump SIGUSR1 produces, the caller gets the path back to collect it
+static void
+dump_log(GDBusMethodInvocation *invocation)
+{
+    gchar *path = g_build_filename(g_get_user_runtime_dir(), TRACE_LOG_DUMP_NAME, NULL);
+
+    if (trace_log_dump(path) < 0)
+        g_dbus_method_invocation_return_error(invocation, G_DBUS_ERROR, G_DBUS_ERROR_FAILED,
+                                              "Failed to write %s: %s", path, g_strerror(errno));
+    else
+        g_dbus_method_invocation_return_value(invocation, g_variant_new("(s)", path));
+
+    g_free(path);
+}
+
+static void
+handle_method_call(GDBusConnection *connection,
+                   const gchar *sender,
+                   const gchar *object_path,
+                   const gchar *interface_name,
+                   const gchar *method_name,
+                   GVariant *parameters,
+                   GDBusMethodInvocation *invocation,
+                   gpointer user_data)
+{
+    GestureHub *hub = user_data;
+
+    if (g_strcmp0(method_name, "Subscribe") == 0) {
+        subscribe(hub, sender);
+        g_dbus_method_invocation_return_value(invocation, NULL);
+    } else if (g_strcmp0(method_name, "Unsubscribe") == 0) {
+        if (unsubscribe(hub, sender))
+            g_dbus_method_invocation_return_value(invocation, NULL);
+        else
+            g_dbus_method_invocation_return_error(invocation, G_DBUS_ERROR, G_DBUS_ERROR_FAILED,
+                                                  "%s is not subscribed", sender);
+    } else if (g_strcmp0(method_name, "DumpLog") == 0) {
+        dump_log(invocation);
+    } else {
+        g_dbus_method_invocation_return_error(invocation, G_DBUS_ERROR, G_DBUS_ERROR_UNKNOWN_METHOD,
+                                              "Unknown method %s", method_name);
+    }
+}
+
+static GVariant *
+handle_get_property(GDBusConnection *connection,
+                    const gchar *sender,
+                    const gchar *object_path,
+                    const gchar *interface_name,
+                    const gchar *property_name,
+                    GError **error,
+                    gpointer user_data)
+{
+    GestureHub *hub = user_data;
+
+    if (g_strcmp0(property_name, "Subscribers") == 0)
+        return g_variant_new_uint32(g_hash_table_size(hub->subscribers));
+
+    return NULL;
+}
+
+static const GDBusInterfaceVTable interface_vtable = {
+    .method_call = handle_method_call,
+    .get_property = handle_get_property,
+};
+
+static void
+on_name_lost(GDBusConnection *connection,
+             const gchar *name,
+             gpointer user_data)
+{
+    g_warning("Lost or could not acquire %s, gestures will not be broadcast", name);
+}
+
+// The hub lives on the session bus next to its consumers (shell,
+// lockscreen), the sensor sessions themselves stay on the system bus
+gboolean
+gesture_hub_init(GestureHub *hub, GestureHubChangedFunc changed, gpointer user_data)
+{
+    GError *error = NULL;
+
+    hub->changed = changed;
+    hub->user_data = user_data;
+    hub->subscribers = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, subscriber_free);
+
+    hub->connection = g_bus_get_sync(G_BUS_TYPE_SESSION, NULL, &error);
+    if (!hub->connection) {
+        g_warning("Failed to connect to the session bus: %s", error->message);
+        g_error_free(error);
+        return FALSE;
+    }
+
+    hub->introspection = g_dbus_node_info_new_for_xml(introspection_xml, NULL);
+    hub->registration_id = g_dbus_connection_register_object(hub->connection,
+                                                             GESTURE_HUB_PATH,
+                                                             hub->introspection->interfaces[0],
+                                                             &interface_vtable,
+                                                             hub,
+                                                             NULL,
+                                                             &error);
+    if (!hub->registration_id) {
+        g_warning("Failed to register %s: %s", GESTURE_HUB_PATH, error->message);
+        g_error_free(error);
+        return FALSE;
+    }
+
+    hub->owner_id = g_bus_own_name_on_connection(hub->connection,
+                                                 GESTURE_HUB_NAME,
+                                                 G_BUS_NAME_OWNER_FLAGS_NONE,
+                                                 NULL,
+                                                 on_name_lost,
+                                                 hub,
+                                                 NULL);
+
+    return TRUE;
+}
+
+void
+gesture_hub_clear(GestureHub *hub)
+{
+    if (hub->owner_id > 0)
+        g_bus_unown_name(hub->owner_id);
+    if (hub->registration_id > 0)
+        g_dbus_connection_unregister_object(hub->connection, hub->registration_id);
+    if (hub->subscribers)
+        g_hash_table_destroy(hub->subscribers);
+    if (hub->introspection)
+        g_dbus_node_info_unref(hub->introspection);
+    if (hub->connection)
+        g_object_unref(hub->connection);
+
+    hub->owner_id = 0;
+    hub->registration_id = 0;
+    hub->subscribers = NULL;
+    hub->introspection = NULL;
+    hub->connection = NULL;
+}
+
+guint
+gesture_hub_subscribers(GestureHub *hub)
+{
+    return hub->subscribers ? g_hash_table_size(hub->subscribers) : 0;
+}
+
+// Nothing goes on the bus while nobody listens. timestamp is the sensorfw
+// (or evdev) time of the event in us, not the time it was noticed.
+void
+gesture_hub_emit(GestureHub *hub, const gchar *kind, guint64 timestamp)
+{
+    GError *error = NULL;
+
+    if (!hub->connection || gesture_hub_subscribers(hub) == 0)
+        return;
+
+    if (!g_dbus_connection_emit_signal(hub->connection,
+                                       NULL,
+                                       GESTURE_HUB_PATH,
+                                       GESTURE_HUB_INTERFACE,
+                                       "Gesture",
+                                       g_variant_new("(st)", kind, timestamp),
+                                       &error)) {
+        g_warning("Failed to emit %s gesture: %s", kind, error->message);
+        g_error_free(error);
+    }
+}
@@ -0,0 +1,32 @@
+// SPDX-License-Identifier: MIT
+// Copyright (C) 2026 Bardia Moshiri <bardia@furilabs.com>
+
+#ifndef GESTURE_HUB_H
+#define GESTURE_HUB_H
+
+#include <glib.h>
+#include <gio/gio.h>
+
+#define GESTURE_HUB_NAME "io.furios.Gesture"
+#define GESTURE_HUB_PATH "/io/furios/Gesture"
+#define GESTURE_HUB_INTERFACE "io.furios.Gesture"
+
+// Called whenever the number of distinct subscribers changes
+typedef void (*GestureHubChangedFunc)(guint subscribers, gpointer user_data);
+
+typedef struct {
+    GDBusConnection *connection;
+    GDBusNodeInfo *introspection;
+    guint owner_id;
+    guint registration_id;
+    GHashTable *subscribers;
+    GestureHubChangedFunc changed;
+    gpointer user_data;
+} GestureHub;
+
+gboolean gesture_hub_init(GestureHub *hub, GestureHubChangedFunc changed, gpointer user_data);
+void gesture_hub_clear(GestureHub *hub);
+guint gesture_hub_subscribers(GestureHub *hub);
+void gesture_hub_emit(GestureHub *hub, const gchar *kind, guint64 timestamp);
+
+#endif // GESTURE_HUB_H
@@ -4,13 +4,31 @@
 
 #include <glib.h>
 #include <gio/gio.h>
+#include <gio/gunixfdlist.h>
+#include <glib-unix.h>
+#include <gmodule.h>
 #include <stdio.h>
+#include <string.h>
 #include <inttypes.h>
-#include <batman/wlrdisplay.h>
-#include "virtkey.h"
+#include "wake-action.h"
+#include "wake-module.h"
+#include "accel-gesture.h"
+#include "trace.h"
+#include "evdev-source.h"
+#include "gesture-hub.h"
+#include "wake-boost.h"
+#include "wake-machine.h"
+#include "power-monitor.h"
+#include "display-monitor.h"
+#include "wake-stats.h"
+#include "wake-resident.h"
+#include "sensorfw.h"
 #include <signal.h>
 #include <unistd.h>
 #include <fcntl.h>
+#include <errno.h>
+#include <time.h>
+#include <sys/resource.h>
 
 #ifdef G_LOG_DOMAIN
 #undef G_LOG_DOMAIN
@@ -20,6 +38,22 @@
 #define PALM_REJECTION_PATH "/sys/kernel/furilabs/palmrejectionmode/common_node/palmrejectionmode"
 #define GLOVE_MODE_PATH "/sys/kernel/prize/glovemode/common_node/glovemode"
 
+#define SENSOR_POLL_INTERVAL_US 500000
+#define ACCEL_POLL_INTERVAL_US 100000
+#define ACCEL_GESTURE_WINDOW_MS 1500
+#define ACCEL_DEFAULT_TILT_ANGLE 35
+#define ACCEL_DEFAULT_PICKUP_THRESHOLD 250
+#define ARM_DEBOUNCE_DEFAULT_MS 250
+#define WAKE_DEDUP_DEFAULT_MS 1000
+#define LOW_BATTERY_POLL_FACTOR 2
+#define SENSOR_RETRY_MIN_S 1
+#define SENSOR_RETRY_MAX_S 300
+#define UNUSED_EXIT_GRACE_S 10
+#define PROXIMITY_BUDGET_US 5000
+#define PROXIMITY_POLL_US 500
+// A wake key injected through uinput clears IdleHint by itself
+#define WAKE_ACTIVITY_GRACE_US 1000000
+
 typedef struct {
     GDBusConnection *dbus_connection;
     gint32 wake_session_id;
@@ -29,25 +63,76 @@ typedef struct {
     GSettings *settings;
     gchar *logind_session_id;
     guint subscription_id;
+    guint sleep_subscription_id;
+    gint sleep_inhibit_fd;
     guint idle_source_id;
+    guint poll_interval_ms; // period of the timer behind idle_source_id, 0 for the first poll
+    gboolean wake_available;
+    gboolean tilt_available;
+    guint retry_source_id;
+    guint retry_interval_s;
+    SensorfwClient sensorfw;
+    guint sensorfw_watch_id;
+    struct wake_machine machine;
+    guint arm_timeout_id;
+    gboolean local_engine;
+    struct accel_gesture accel;
+    gboolean recording;
+    struct trace_writer trace;
+    gint32 trace_accel_session_id;
+    gint32 proximity_session_id;
+    guint dropped_wakes;
+    WakeAction wake_action;
+    GModule *wake_module;
+    gboolean wake_module_failed; // not retried until a setting changes
+    const WakeModule *wake;
+    EvdevSource evdev;
+    GestureHub hub;
+    guint exit_source_id;
+    WakeBoost boost;
+    PowerMonitor power;
+    DisplayMonitor display;
+    gint64 blanked_at; // screen off time while sensors are not armed yet, 0 otherwise
+    gint32 blank_trigger;
+    WakeStats wake_stats;
+    guint tilt_resume_source_id;
+    WakeResident resident;
 } GestureSensors;
 
 static GestureSensors *g_app = NULL;
 
+static gchar *record_path = NULL;
+static gchar *replay_path = NULL;
+static gboolean replay_wake = FALSE;
+static gboolean replay_sensorfw = FALSE;
+static gboolean early_wake_module = FALSE;
+
+static GOptionEntry option_entries[] = {
+    { "record", 0, 0, G_OPTION_ARG_FILENAME, &record_path, "Append sensor readings and idle/screen transitions to a binary trace", "FILE" },
+    { "replay", 0, 0, G_OPTION_ARG_FILENAME, &replay_path, "Run a recorded trace through the detection path and exit", "FILE" },
+    { "replay-wake", 0, 0, G_OPTION_ARG_NONE, &replay_wake, "With --replay, run the wake backends for every wake the replay decides on", NULL },
+    { "replay-sensorfw", 0, 0, G_OPTION_ARG_NONE, &replay_sensorfw, "With --replay, also fetch every replayed reading from sensorfw on the system bus", NULL },
+    { "load-wake-module", 0, 0, G_OPTION_ARG_NONE, &early_wake_module, "Load the wake module before the startup record instead of at the first arm, to measure a fully armed start", NULL },
+    G_OPTION_ENTRY_NULL
+};
+
 void
 write_to_file(const char *path,
               const char *value)
 {
-  g_debug("Attempting to write to %s: %s\n", path, value);
-
   int fd = open(path, O_WRONLY);
   if (fd == -1) {
+    trace_log(TRACE_RECORD_SYSFS_WRITE, 0, errno, value[0], 0);
     perror("open");
     return;
   }
 
-  if (write(fd, value, strlen(value)) == -1)
+  if (write(fd, value, strlen(value)) == -1) {
+    trace_log(TRACE_RECORD_SYSFS_WRITE, 0, errno, value[0], 0);
     perror("write");
+  } else {
+    trace_log(TRACE_RECORD_SYSFS_WRITE, 0, 0, value[0], 0);
+  }
 
   close(fd);
 }
@@ -70,486 +155,1098 @@ read_from_file(const char *path)
   return strdup(buffer);
 }
 
-void
-send_wake_key()
+static void
+trace_append(GestureSensors *app,
+             enum trace_record_type type,
+             guint64 timestamp,
+             gint32 v0, gint32 v1, gint32 v2)
 {
-    struct wtype wtype;
-    memset(&wtype, 0, sizeof(wtype));
+    struct trace_record record = {
+        .time = g_get_monotonic_time(),
+        .timestamp = timestamp,
+        .type = type,
+        .value = { v0, v1, v2 },
+    };
 
-    wtype.commands = calloc(1, sizeof(wtype.commands[0]));
-    wtype.command_count = 1;
+    trace_log_record(&record);
 
-    struct wtype_command *cmd = &wtype.commands[0];
-    cmd->type = WTYPE_COMMAND_TEXT;
-    xkb_keysym_t ks = xkb_keysym_from_name("Escape", XKB_KEYSYM_CASE_INSENSITIVE);
-    if (ks == XKB_KEY_NoSymbol) {
-        g_printerr("Unknown key 'Escape'");
+    if (!app->recording)
         return;
+
+    if (trace_writer_append(&app->trace, &record) < 0) {
+        g_warning("Failed to append to trace, recording stopped: %s", g_strerror(errno));
+        trace_writer_close(&app->trace);
+        app->recording = FALSE;
     }
+}
 
-    cmd->key_codes = malloc(sizeof(cmd->key_codes[0]));
-    cmd->key_codes_len = 1;
-    cmd->key_codes[0] = get_key_code_by_xkb(&wtype, ks);
-    cmd->delay_ms = 0;
 
-    wtype.display = wl_display_connect(NULL);
-    if (wtype.display == NULL) {
-        g_printerr("Wayland connection failed\n");
-        return;
+static void
+record_sensorfw_call(gint32 method, gint64 elapsed_us, gboolean ok, gpointer user_data)
+{
+    trace_append((GestureSensors *)user_data, TRACE_RECORD_SENSORFW, 0, method, elapsed_us, ok);
+}
+
+static void
+on_sensorfw_vanished(GDBusConnection *connection,
+                     const gchar *name,
+                     gpointer user_data)
+{
+    GestureSensors *app = (GestureSensors *)user_data;
+
+    sensorfw_forget_plugins(&app->sensorfw);
+    wake_machine_sessions_lost(&app->machine);
+}
+
+
+// The sensor only runs while a latched gesture is checked. The reading
+// cached from before the start is the baseline, the gate waits up to
+// PROXIMITY_BUDGET_US for a newer sample and stops the sensor again before
+// returning. Returns TRUE only when that sample reports being covered, a
+// stale sample or any failure lets the wake through rather than leaving the
+// user locked out.
+static gboolean
+proximity_covered(GestureSensors *app)
+{
+    gint64 started = g_get_monotonic_time();
+    guint64 baseline = 0, timestamp = 0;
+    guint32 proximity = 0;
+    gboolean fresh = FALSE;
+
+    if (!get_proximity_reading(&app->sensorfw, &baseline, &proximity))
+        return FALSE;
+
+    set_proximity_sensor_running(&app->sensorfw, app->proximity_session_id, TRUE);
+    while (get_proximity_reading(&app->sensorfw, &timestamp, &proximity)) {
+        fresh = timestamp > baseline;
+        if (fresh || g_get_monotonic_time() - started >= PROXIMITY_BUDGET_US)
+            break;
+        g_usleep(PROXIMITY_POLL_US);
     }
-    wtype.registry = wl_display_get_registry(wtype.display);
-    wl_registry_add_listener(wtype.registry, &registry_listener, &wtype);
-    wl_display_dispatch(wtype.display);
-    wl_display_roundtrip(wtype.display);
+    set_proximity_sensor_running(&app->sensorfw, app->proximity_session_id, FALSE);
 
-    if (wtype.manager == NULL) {
-        g_printerr("Compositor does not support the virtual keyboard protocol\n");
-        return;
+    gint64 elapsed = g_get_monotonic_time() - started;
+
+    trace_append(app, TRACE_RECORD_PROXIMITY, timestamp, proximity, elapsed, fresh);
+    if (!fresh) {
+        g_debug("No proximity sample within %" G_GINT64_FORMAT " us, not gating", elapsed);
+        return FALSE;
     }
-    if (wtype.seat == NULL) {
-        g_printerr("No seat found\n");
-        return;
+
+    return proximity != 0;
+}
+
+static gboolean
+wake_blocked_by_proximity(GestureSensors *app)
+{
+    if (app->proximity_session_id == -1)
+        return FALSE;
+
+    if (!proximity_covered(app))
+        return FALSE;
+
+    app->dropped_wakes++;
+    g_info("Proximity sensor covered, dropping wake (%u dropped so far)", app->dropped_wakes);
+    return TRUE;
+}
+
+static gboolean
+use_local_engine(GestureSensors *app)
+{
+    gchar *engine = g_settings_get_string(app->settings, "gesture-engine");
+    gboolean local = (g_strcmp0(engine, "local") == 0);
+    g_free(engine);
+    return local;
+}
+
+static void
+init_local_engine(GestureSensors *app)
+{
+    struct accel_gesture_config config = {
+        .tilt_angle = ACCEL_DEFAULT_TILT_ANGLE,
+        .pickup_threshold = ACCEL_DEFAULT_PICKUP_THRESHOLD,
+        .window_ms = ACCEL_GESTURE_WINDOW_MS,
+    };
+
+    // Replay may run on a box without the schema installed
+    if (app->settings) {
+        config.tilt_angle = g_settings_get_int(app->settings, "local-tilt-angle");
+        config.pickup_threshold = g_settings_get_int(app->settings, "local-pickup-threshold");
     }
 
-    wtype.keyboard = zwp_virtual_keyboard_manager_v1_create_virtual_keyboard(
-        wtype.manager, wtype.seat
-    );
+    accel_gesture_init(&app->accel, &config);
+}
 
-    upload_keymap(&wtype);
-    run_commands(&wtype);
+// The tilt source is either sensorfw's tiltdetectorsensor plugin or the
+// accelerometer feeding the in-daemon recognizer, picked per device through
+// the gesture-engine key each time the sensors are armed
+static gint32
+request_tilt_source(GestureSensors *app)
+{
+    app->local_engine = use_local_engine(app);
+    if (!app->local_engine)
+        return request_tilt_sensor(&app->sensorfw);
 
-    g_debug("Escape key sent to seat");
+    init_local_engine(app);
 
-    free(wtype.commands);
-    free(wtype.keymap);
-    zwp_virtual_keyboard_v1_destroy(wtype.keyboard);
-    zwp_virtual_keyboard_manager_v1_destroy(wtype.manager);
-    wl_registry_destroy(wtype.registry);
-    wl_display_disconnect(wtype.display);
+    return request_accel_sensor(&app->sensorfw);
 }
 
-gint32
-request_wake_sensor(GestureSensors *app)
+static void
+release_tilt_source(GestureSensors *app, gint32 session_id)
 {
-    GVariant *result;
-    GError *error = NULL;
-    gint32 session_id = -1;
+    if (app->local_engine)
+        release_accel_sensor(&app->sensorfw, session_id);
+    else
+        release_tilt_sensor(&app->sensorfw, session_id);
+}
 
-    result = g_dbus_connection_call_sync(app->dbus_connection,
-                                         "com.nokia.SensorService",
-                                         "/SensorManager",
-                                         "local.SensorManager",
-                                         "loadPlugin",
-                                         g_variant_new("(s)", "wakegesturesensor"),
-                                         NULL,
-                                         G_DBUS_CALL_FLAGS_NONE,
-                                         -1,
-                                         NULL,
-                                         &error);
+static guint32
+feed_local_engine(GestureSensors *app, const struct accel_sample *sample)
+{
+    enum accel_gesture_type type = accel_gesture_feed(&app->accel, sample, 1);
+    if (type == ACCEL_GESTURE_NONE)
+        return 0;
 
-    if (error) {
-        g_warning("Failed to load plugin: %s", error->message);
-        g_error_free(error);
-        return -1;
+    g_debug("Local engine detected %s", accel_gesture_name(type));
+    return 1;
+}
+
+static guint32
+get_tilt_source_reading(GestureSensors *app, guint64 *timestamp)
+{
+    struct accel_sample sample;
+
+    if (!app->local_engine) {
+        guint32 tilt = get_tilt_sensor_reading(&app->sensorfw, timestamp);
+        trace_append(app, TRACE_RECORD_TILT, *timestamp, tilt, 0, 0);
+
+        // Traces carry raw accelerometer data too so the local engine can be
+        // compared against the plugin on the same motion
+        if (app->trace_accel_session_id != -1 && get_accel_sensor_reading(&app->sensorfw, &sample))
+            trace_append(app, TRACE_RECORD_ACCEL, sample.timestamp, sample.x, sample.y, sample.z);
+
+        return tilt;
     }
 
-    g_variant_unref(result);
+    if (!get_accel_sensor_reading(&app->sensorfw, &sample))
+        return 0;
 
-    result = g_dbus_connection_call_sync(app->dbus_connection,
-                                         "com.nokia.SensorService",
-                                         "/SensorManager",
-                                         "local.SensorManager",
-                                         "requestSensor",
-                                         g_variant_new("(sx)", "wakegesturesensor", (gint64)getpid()),
-                                         G_VARIANT_TYPE("(i)"),
-                                         G_DBUS_CALL_FLAGS_NONE,
-                                         -1,
-                                         NULL,
-                                         &error);
+    trace_append(app, TRACE_RECORD_ACCEL, sample.timestamp, sample.x, sample.y, sample.z);
+    *timestamp = sample.timestamp;
 
-    if (error) {
-        g_warning("Failed to request sensor: %s", error->message);
-        g_error_free(error);
-        return -1;
+    return feed_local_engine(app, &sample);
+}
+
+static const gchar *
+tilt_source_plugin(GestureSensors *app)
+{
+    return use_local_engine(app) ? "accelerometersensor" : "tiltdetectorsensor";
+}
+
+static void
+probe_sensors(GestureSensors *app)
+{
+    app->wake_available = probe_sensor_plugin(&app->sensorfw, "wakegesturesensor");
+    app->tilt_available = probe_sensor_plugin(&app->sensorfw, tilt_source_plugin(app));
+
+    g_debug("Wake sensor %s, tilt source %s",
+            app->wake_available ? "available" : "missing",
+            app->tilt_available ? "available" : "missing");
+}
+
+static void schedule_sensor_retry(GestureSensors *app);
+
+// Sensors that were missing are probed again with exponential backoff. One
+// that shows up is requested right away while armed, otherwise it joins at
+// the next arm.
+static gboolean
+retry_missing_sensors(gpointer user_data)
+{
+    GestureSensors *app = (GestureSensors *)user_data;
+    gboolean armed = (app->machine.state == WAKE_MACHINE_ARMED);
+
+    app->retry_source_id = 0;
+
+    if (!app->wake_available && probe_sensor_plugin(&app->sensorfw, "wakegesturesensor")) {
+        g_debug("Wake sensor became available");
+        app->wake_available = TRUE;
+        if (armed && app->wake_session_id == -1) {
+            app->wake_session_id = request_wake_sensor(&app->sensorfw);
+            app->wake_available = (app->wake_session_id != -1);
+        }
     }
 
-    g_variant_get(result, "(i)", &session_id);
-    g_variant_unref(result);
+    if (!app->tilt_available && probe_sensor_plugin(&app->sensorfw, tilt_source_plugin(app))) {
+        g_debug("Tilt source became available");
+        app->tilt_available = TRUE;
+        if (armed && app->tilt_session_id == -1) {
+            app->tilt_session_id = request_tilt_source(app);
+            app->tilt_available = (app->tilt_session_id != -1);
+        }
+    }
+
+    if (app->wake_available && app->tilt_available) {
+        app->retry_interval_s = 0;
+        return G_SOURCE_REMOVE;
+    }
+
+    app->retry_interval_s = MIN(app->retry_interval_s * 2, SENSOR_RETRY_MAX_S);
+    schedule_sensor_retry(app);
+
+    return G_SOURCE_REMOVE;
+}
+
+static void
+schedule_sensor_retry(GestureSensors *app)
+{
+    if (app->retry_source_id > 0)
+        return;
+
+    if (app->retry_interval_s == 0)
+        app->retry_interval_s = SENSOR_RETRY_MIN_S;
+
+    g_debug("Retrying missing sensors in %us", app->retry_interval_s);
+    app->retry_source_id = g_timeout_add_seconds(app->retry_interval_s, retry_missing_sensors, app);
+}
+
+// Battery policy on top of the settings. It is re-evaluated on every UPower
+// change, what needs new sensor sessions takes effect at the next arm.
+static gboolean
+battery_low(GestureSensors *app)
+{
+    guint threshold = g_settings_get_uint(app->settings, "low-battery-percentage");
+
+    return threshold > 0 && app->power.available && app->power.on_battery &&
+           app->power.percentage <= threshold;
+}
+
+// Dropping tilt and polling less go together, slower polls also delay
+// wake gestures so they only apply when the user opted into the trade
+static gboolean
+battery_saving(GestureSensors *app)
+{
+    return battery_low(app) && g_settings_get_boolean(app->settings, "low-battery-disable-tilt");
+}
+
+static gboolean
+proximity_gate_wanted(GestureSensors *app)
+{
+    return g_settings_get_boolean(app->settings, "proximity-gate-enabled") ||
+           (app->power.on_battery && g_settings_get_boolean(app->settings, "battery-proximity-gate"));
+}
+
+// Runs with whatever subset of wake and tilt is present, FALSE only when
+// neither could be requested. Missing ones are left to the retry timer
+// rather than a process restart.
+static gboolean
+request_sensors(GestureSensors *app)
+{
+    if (app->wake_available)
+        app->wake_session_id = request_wake_sensor(&app->sensorfw);
+    if (app->tilt_available)
+        app->tilt_session_id = request_tilt_source(app);
+    if (app->recording && !app->local_engine)
+        app->trace_accel_session_id = request_accel_sensor(&app->sensorfw);
+    // A missing proximity sensor only disables the gate
+    if (proximity_gate_wanted(app))
+        app->proximity_session_id = request_proximity_sensor(&app->sensorfw);
+
+    app->wake_available = (app->wake_session_id != -1);
+    app->tilt_available = (app->tilt_session_id != -1);
+    if (!app->wake_available || !app->tilt_available)
+        schedule_sensor_retry(app);
+
+    return app->wake_available || app->tilt_available;
+}
+
+static void
+release_sensors(GestureSensors *app)
+{
+    if (app->wake_session_id != -1)
+        release_wake_sensor(&app->sensorfw, app->wake_session_id);
+    if (app->tilt_session_id != -1)
+        release_tilt_source(app, app->tilt_session_id);
+    if (app->trace_accel_session_id != -1)
+        release_accel_sensor(&app->sensorfw, app->trace_accel_session_id);
+    if (app->proximity_session_id != -1)
+        release_proximity_sensor(&app->sensorfw, app->proximity_session_id);
+
+    app->wake_session_id = -1;
+    app->tilt_session_id = -1;
+    app->trace_accel_session_id = -1;
+    app->proximity_session_id = -1;
+}
+
+static gchar*
+get_session_id(GestureSensors *app)
+{
+    GVariant *result;
+    GError *error = NULL;
+    gchar *session_id = NULL;
 
     result = g_dbus_connection_call_sync(app->dbus_connection,
-                                         "com.nokia.SensorService",
-                                         "/SensorManager/wakegesturesensor",
-                                         "local.WakeGestureSensor",
-                                         "start",
-                                         g_variant_new("(i)", session_id),
+                                         "org.freedesktop.login1",
+                                         "/org/freedesktop/login1",
+                                         "org.freedesktop.login1.Manager",
+                                         "ListSessions",
                                          NULL,
+                                         G_VARIANT_TYPE("(a(susso))"),
                                          G_DBUS_CALL_FLAGS_NONE,
                                          -1,
                                          NULL,
                                          &error);
 
     if (error) {
-        g_warning("Failed to start sensor: %s", error->message);
+        g_warning("Failed to list sessions: %s", error->message);
         g_error_free(error);
+        return NULL;
     }
 
+    GVariantIter *iter;
+    const gchar *id, *seat;
+
+    // Borrowed strings, breaking out of g_variant_iter_loop() early would
+    // otherwise leak the current iteration's copies
+    g_variant_get(result, "(a(susso))", &iter);
+    while (g_variant_iter_loop(iter, "(&su&s&s&o)", &id, NULL, NULL, &seat, NULL)) {
+        if (g_strcmp0(seat, "seat0") == 0) {
+            session_id = g_strdup(id);
+            break;
+        }
+    }
+
+    g_variant_iter_free(iter);
     g_variant_unref(result);
 
     return session_id;
 }
 
-void
-release_wake_sensor(GestureSensors *app, gint32 session_id)
+// Only sensors that actually latched are reset, an idle one has nothing to
+// clear and each reset is a synchronous round trip to sensorfw
+static void
+reset_sensors(GestureSensors *app, gboolean wake_latched, gboolean tilt_latched)
 {
     GVariant *result;
     GError *error = NULL;
 
-    result = g_dbus_connection_call_sync(app->dbus_connection,
-                                         "com.nokia.SensorService",
-                                         "/SensorManager/wakegesturesensor",
-                                         "local.WakeGestureSensor",
-                                         "stop",
-                                         g_variant_new("(i)", session_id),
-                                         NULL,
-                                         G_DBUS_CALL_FLAGS_NONE,
-                                         -1,
-                                         NULL,
-                                         &error);
+    if (wake_latched) {
+        result = sensorfw_call(&app->sensorfw,
+                               "/SensorManager/wakegesturesensor",
+                               "local.WakeGestureSensor",
+                               "resetWakeGesture",
+                               NULL,
+                               NULL,
+                               &error);
+
+        if (error) {
+            g_warning("Failed to reset wake sensor: %s", error->message);
+            g_clear_error(&error);
+        }
 
-    if (error) {
-        g_warning("Failed to stop sensor: %s", error->message);
-        g_error_free(error);
+        if (result)
+            g_variant_unref(result);
     }
 
-    if (result)
-        g_variant_unref(result);
+    if (!tilt_latched)
+        return;
 
-    result = g_dbus_connection_call_sync(app->dbus_connection,
-                                         "com.nokia.SensorService",
-                                         "/SensorManager",
-                                         "local.SensorManager",
-                                         "releaseSensor",
-                                         g_variant_new("(six)", "wakegesturesensor", session_id, (gint64)getpid()),
-                                         NULL,
-                                         G_DBUS_CALL_FLAGS_NONE,
-                                         -1,
-                                         NULL,
-                                         &error);
+    if (app->local_engine) {
+        accel_gesture_reset(&app->accel);
+        return;
+    }
+
+    result = sensorfw_call(&app->sensorfw,
+                           "/SensorManager/tiltdetectorsensor",
+                           "local.TiltDetectorSensor",
+                           "resetTiltDetector",
+                           NULL,
+                           NULL,
+                           &error);
 
     if (error) {
-        g_warning("Failed to release sensor: %s", error->message);
-        g_error_free(error);
+        g_warning("Failed to reset tilt sensor: %s", error->message);
+        g_clear_error(&error);
     }
 
     if (result)
         g_variant_unref(result);
 }
 
-guint32
-get_wake_sensor_reading(GestureSensors *app)
+// Resident set size from statm, reported at startup and once the wake
+// module is in so the cost of each configuration shows in the event log
+static gint32
+resident_kb(void)
 {
-    GVariant *result;
-    GError *error = NULL;
-    guint32 wake_gesture = 0;
-    result = g_dbus_connection_call_sync(app->dbus_connection,
-                                         "com.nokia.SensorService",
-                                         "/SensorManager/wakegesturesensor",
-                                         "org.freedesktop.DBus.Properties",
-                                         "Get",
-                                         g_variant_new("(ss)", "local.WakeGestureSensor", "wakegesture"),
-                                         G_VARIANT_TYPE("(v)"),
-                                         G_DBUS_CALL_FLAGS_NONE,
-                                         -1,
-                                         NULL,
-                                         &error);
+    unsigned long size, resident;
+    FILE *statm = fopen("/proc/self/statm", "r");
+    gint32 kb = 0;
 
-    if (error) {
-        g_warning("Failed to get sensor reading: %s", error->message);
-        g_error_free(error);
+    if (!statm)
         return 0;
+    if (fscanf(statm, "%lu %lu", &size, &resident) == 2)
+        kb = resident * (sysconf(_SC_PAGESIZE) / 1024);
+    fclose(statm);
+
+    return kb;
+}
+
+// Time since the kernel started the process, which takes in exec, dynamic
+// linking and everything before main(). The start time is in clock ticks
+// since boot, so this is only good to the tick. -1 if it cannot be read.
+static gint64
+process_age_us(void)
+{
+    gchar *stat = NULL;
+    unsigned long long start_ticks;
+    struct timespec now;
+    gint64 age = -1;
+
+    if (!g_file_get_contents("/proc/self/stat", &stat, NULL, NULL))
+        return -1;
+
+    // The command name may hold spaces and parentheses, fields restart after
+    // the last ')' with field 3, the start time is field 22
+    const gchar *fields = strrchr(stat, ')');
+    if (fields &&
+        sscanf(fields + 1, " %*c %*d %*d %*d %*d %*d %*u %*u %*u %*u %*u %*u %*u %*d %*d %*d %*d %*d %*d %llu",
+               &start_ticks) == 1 &&
+        clock_gettime(CLOCK_BOOTTIME, &now) == 0) {
+        gint64 start_us = start_ticks * G_USEC_PER_SEC / sysconf(_SC_CLK_TCK);
+        age = (gint64)now.tv_sec * G_USEC_PER_SEC + now.tv_nsec / 1000 - start_us;
     }
 
-    GVariant *value;
-    g_variant_get(result, "(v)", &value);
-    g_variant_get(value, "(tu)", NULL, &wake_gesture);
+    g_free(stat);
+    return age;
+}
 
-    g_variant_unref(value);
-    g_variant_unref(result);
+// Loaded the first time the sensors arm or input wakes are enabled and kept
+// until exit. A module that fails to load is not tried again on every poll
+// and wake, only after a setting changes or the daemon restarts.
+static gboolean
+load_wake_module(GestureSensors *app)
+{
+    const gchar *path = g_getenv(WAKE_MODULE_PATH_ENV);
+    gchar *default_path = NULL;
+    gpointer symbol = NULL;
+
+    if (app->wake)
+        return TRUE;
+    if (app->wake_module_failed)
+        return FALSE;
+
+    if (!path)
+        path = default_path = g_build_filename(WAKE_MODULE_DIR, WAKE_MODULE_NAME, NULL);
+
+    gint64 started = g_get_monotonic_time();
+    app->wake_module = g_module_open(path, G_MODULE_BIND_LOCAL);
+    if (!app->wake_module) {
+        g_warning("Failed to load wake module: %s", g_module_error());
+    } else if (!g_module_symbol(app->wake_module, WAKE_MODULE_SYMBOL, &symbol) || !symbol) {
+        g_warning("Wake module %s has no %s", path, WAKE_MODULE_SYMBOL);
+        g_module_close(app->wake_module);
+        app->wake_module = NULL;
+    } else {
+        app->wake = symbol;
+        app->wake->init(&app->wake_action, app->dbus_connection);
+        if (app->logind_session_id)
+            app->wake->set_session(&app->wake_action, app->logind_session_id);
+        if (app->settings) {
+            gchar *backend = g_settings_get_string(app->settings, "wake-backend");
+            app->wake->set_backend(&app->wake_action, backend);
+            g_free(backend);
+        }
+    }
+
+    app->wake_module_failed = (app->wake == NULL);
 
-    return wake_gesture;
+    gint32 kb = resident_kb();
+    trace_append(app, TRACE_RECORD_WAKE_MODULE, 0, g_get_monotonic_time() - started,
+                 app->wake != NULL, kb);
+    if (app->wake)
+        g_debug("Wake module loaded from %s, %d KiB resident", path, kb);
+
+    g_free(default_path);
+    return app->wake != NULL;
 }
 
-gint32
-request_tilt_sensor(GestureSensors *app)
+// Ends the boost window opened at detection and records how long the whole
+// wake path took so boosted and unboosted wakes can be compared on replay
+static void
+run_wake_action(GestureSensors *app, gint64 started, gboolean boosted)
 {
-    GVariant *result;
-    GError *error = NULL;
-    gint32 session_id = -1;
+    // The load failure was already warned about
+    if (!load_wake_module(app))
+        g_debug("Wake module unavailable, cannot wake the screen");
+    else if (!app->wake->run(&app->wake_action, app->display.available && app->display.off))
+        g_warning("All wake backends failed");
+
+    wake_boost_leave(&app->boost);
+    trace_append(app, TRACE_RECORD_WAKE_PATH, 0, g_get_monotonic_time() - started,
+                 boosted, app->wake_action.last_backend);
+}
 
-    result = g_dbus_connection_call_sync(app->dbus_connection,
-                                         "com.nokia.SensorService",
-                                         "/SensorManager",
-                                         "local.SensorManager",
-                                         "loadPlugin",
-                                         g_variant_new("(s)", "tiltdetectorsensor"),
-                                         NULL,
-                                         G_DBUS_CALL_FLAGS_NONE,
-                                         -1,
-                                         NULL,
-                                         &error);
+// After hours idle the first wake can fault the wake path back in from
+// flash. While idle it is kept locked in memory, prebuilt keyboard buffers
+// first, up to wake-resident-max-kb.
+static void
+lock_wake_path(GestureSensors *app)
+{
+    struct wtype *keyboard = &app->wake_action.keyboard;
+    WakeResidentRange buffers[] = {
+        { keyboard->arena.base, keyboard->arena.size },
+        { keyboard->keymap, keyboard->keymap_cap * sizeof(*keyboard->keymap) },
+        { keyboard->xkb_index.slots, keyboard->xkb_index.cap * sizeof(*keyboard->xkb_index.slots) },
+        { keyboard->wchr_index.slots, keyboard->wchr_index.cap * sizeof(*keyboard->wchr_index.slots) },
+    };
 
-    if (error) {
-        g_warning("Failed to load tilt sensor plugin: %s", error->message);
-        g_error_free(error);
-        return -1;
+    if (app->resident.cap == 0 || app->resident.n_locked > 0)
+        return;
+
+    gint64 started = g_get_monotonic_time();
+    gsize locked = wake_resident_lock(&app->resident, buffers, G_N_ELEMENTS(buffers));
+    trace_append(app, TRACE_RECORD_RESIDENT, 0, locked / 1024, app->resident.error,
+                 g_get_monotonic_time() - started);
+}
+
+static void
+unlock_wake_path(GestureSensors *app)
+{
+    if (app->resident.n_locked == 0)
+        return;
+
+    wake_resident_unlock(&app->resident);
+    trace_append(app, TRACE_RECORD_RESIDENT, 0, 0, 0, 0);
+}
+
+static void set_standby_overrides(GestureSensors *app);
+static gboolean check_sensors(gpointer user_data);
+static gboolean arm_sensors(gpointer user_data);
+
+// Carries out what the wake machine decided, in the order the actions are
+// declared except for the wake itself. That runs first, right after the
+// boost, so the screen does not wait on the sensorfw round trips that cycle
+// the sessions.
+static void
+apply_actions(GestureSensors *app, unsigned int actions)
+{
+    gint64 started = g_get_monotonic_time();
+
+    if (actions == 0)
+        return;
+
+    trace_append(app, TRACE_RECORD_ARM, 0, app->machine.state, actions, 0);
+
+    if (actions & WAKE_MACHINE_WAKE)
+        run_wake_action(app, started, wake_boost_enter(&app->boost));
+
+    if (actions & WAKE_MACHINE_EMIT_WAKE)
+        gesture_hub_emit(&app->hub, "wake", app->machine.wake_latched_at);
+    if (actions & WAKE_MACHINE_EMIT_TILT)
+        gesture_hub_emit(&app->hub, "tilt", app->machine.tilt_latched_at);
+
+    if ((actions & WAKE_MACHINE_CANCEL_ARM) && app->arm_timeout_id > 0) {
+        g_debug("Idle ended within the debounce window, not arming");
+        g_source_remove(app->arm_timeout_id);
+        app->arm_timeout_id = 0;
     }
 
-    g_variant_unref(result);
+    if ((actions & WAKE_MACHINE_STOP_POLLING) && app->idle_source_id > 0) {
+        g_debug("Stopping sensor checks");
+        g_source_remove(app->idle_source_id);
+        app->idle_source_id = 0;
+    }
 
-    result = g_dbus_connection_call_sync(app->dbus_connection,
-                                         "com.nokia.SensorService",
-                                         "/SensorManager",
-                                         "local.SensorManager",
-                                         "requestSensor",
-                                         g_variant_new("(sx)", "tiltdetectorsensor", (gint64)getpid()),
-                                         G_VARIANT_TYPE("(i)"),
-                                         G_DBUS_CALL_FLAGS_NONE,
-                                         -1,
-                                         NULL,
-                                         &error);
+    // Prepared sessions are reset on arm whether or not both were requested
+    if (actions & (WAKE_MACHINE_RESET_WAKE | WAKE_MACHINE_RESET_TILT))
+        reset_sensors(app,
+                      (actions & WAKE_MACHINE_RESET_WAKE) && app->wake_session_id != -1,
+                      (actions & WAKE_MACHINE_RESET_TILT) && app->tilt_session_id != -1);
 
-    if (error) {
-        g_warning("Failed to request tilt sensor: %s", error->message);
-        g_error_free(error);
-        return -1;
+    if (actions & WAKE_MACHINE_RELEASE)
+        release_sensors(app);
+
+    // Loading on the first arm keeps the dlopen off the wake path
+    if (actions & WAKE_MACHINE_ACQUIRE)
+        load_wake_module(app);
+
+    if ((actions & WAKE_MACHINE_ACQUIRE) && !request_sensors(app)) {
+        g_warning("No gesture sensors available, not arming");
+        wake_machine_acquire_failed(&app->machine);
+        actions &= ~(WAKE_MACHINE_START_POLLING | WAKE_MACHINE_STANDBY);
     }
 
-    g_variant_get(result, "(i)", &session_id);
-    g_variant_unref(result);
+    if ((actions & WAKE_MACHINE_START_POLLING) && app->idle_source_id == 0) {
+        g_debug("Starting sensor checks");
+        app->poll_interval_ms = 0;
+        app->idle_source_id = g_idle_add(check_sensors, app);
+    }
 
-    result = g_dbus_connection_call_sync(app->dbus_connection,
-                                         "com.nokia.SensorService",
-                                         "/SensorManager/tiltdetectorsensor",
-                                         "local.TiltDetectorSensor",
-                                         "start",
-                                         g_variant_new("(i)", session_id),
-                                         NULL,
-                                         G_DBUS_CALL_FLAGS_NONE,
-                                         -1,
-                                         NULL,
-                                         &error);
+    if (actions & WAKE_MACHINE_SCHEDULE_ARM) {
+        gint64 delay_us = (gint64)app->machine.arm_deadline - g_get_monotonic_time();
 
-    if (error) {
-        g_warning("Failed to start tilt sensor: %s", error->message);
-        g_error_free(error);
+        if (app->arm_timeout_id > 0)
+            g_source_remove(app->arm_timeout_id);
+        app->arm_timeout_id = g_timeout_add(MAX(delay_us + 999, 0) / 1000, arm_sensors, app);
     }
 
-    g_variant_unref(result);
+    if (actions & WAKE_MACHINE_STANDBY)
+        set_standby_overrides(app);
 
-    return session_id;
+    // Sensors are up, which closes the window a gesture after screen off
+    // would have been lost in
+    if (app->blanked_at && app->machine.state == WAKE_MACHINE_ARMED) {
+        gint64 gap = g_get_monotonic_time() - app->blanked_at;
+        gboolean prepared = !(actions & WAKE_MACHINE_ACQUIRE);
+
+        trace_append(app, TRACE_RECORD_ARM_GAP, 0, gap, app->blank_trigger, prepared);
+        g_debug("Sensors armed %.0f ms after screen off%s", gap / 1e3, prepared ? ", prepared ahead" : "");
+        app->blanked_at = 0;
+    }
 }
 
-void
-release_tilt_sensor(GestureSensors *app, gint32 session_id)
+// check_sensors() stops by returning G_SOURCE_REMOVE rather than removing
+// the source it runs from
+static gboolean
+apply_poll_actions(GestureSensors *app, unsigned int actions)
 {
-    GVariant *result;
-    GError *error = NULL;
+    if (actions & WAKE_MACHINE_STOP_POLLING)
+        app->idle_source_id = 0;
 
-    result = g_dbus_connection_call_sync(app->dbus_connection,
-                                         "com.nokia.SensorService",
-                                         "/SensorManager/tiltdetectorsensor",
-                                         "local.TiltDetectorSensor",
-                                         "stop",
-                                         g_variant_new("(i)", session_id),
-                                         NULL,
-                                         G_DBUS_CALL_FLAGS_NONE,
-                                         -1,
-                                         NULL,
-                                         &error);
+    apply_actions(app, actions);
 
-    if (error) {
-        g_warning("Failed to stop tilt sensor: %s", error->message);
-        g_error_free(error);
+    return app->idle_source_id > 0 ? G_SOURCE_CONTINUE : G_SOURCE_REMOVE;
+}
+
+// Touch panel gestures are latched by the panel itself and arrive as key
+// presses, they skip sensorfw but share the proximity gate. Their evdev
+// timestamps get a dedup window of their own, apart from sensorfw time.
+static void
+on_input_wake(guint16 code, guint64 timestamp, gpointer user_data)
+{
+    GestureSensors *app = (GestureSensors *)user_data;
+
+    g_debug("Input wake key %u", code);
+    trace_append(app, TRACE_RECORD_INPUT, timestamp, code, 0, 0);
+    gesture_hub_emit(&app->hub, "input", timestamp);
+
+    unsigned int actions = wake_machine_input(&app->machine, timestamp);
+    if (!actions) {
+        g_debug("Screen in use or same motion as the last wake, not waking");
+        return;
     }
 
-    if (result)
-        g_variant_unref(result);
+    if (wake_blocked_by_proximity(app)) {
+        wake_machine_blocked(&app->machine, actions);
+        return;
+    }
 
-    result = g_dbus_connection_call_sync(app->dbus_connection,
-                                         "com.nokia.SensorService",
-                                         "/SensorManager",
-                                         "local.SensorManager",
-                                         "releaseSensor",
-                                         g_variant_new("(six)", "tiltdetectorsensor", session_id, (gint64)getpid()),
-                                         NULL,
-                                         G_DBUS_CALL_FLAGS_NONE,
-                                         -1,
-                                         NULL,
-                                         &error);
+    wake_stats_woke(&app->wake_stats, WAKE_SOURCE_BIT(WAKE_SOURCE_INPUT), g_get_monotonic_time());
+    apply_actions(app, actions);
+}
+
+// Polls run from a timer rather than sleeping in the callback, so the main
+// loop keeps dispatching D-Bus and hub traffic between samples. The source
+// is only replaced when the period changes.
+static gboolean
+schedule_poll(GestureSensors *app, guint interval_ms)
+{
+    if (interval_ms == app->poll_interval_ms)
+        return G_SOURCE_CONTINUE;
+
+    app->poll_interval_ms = interval_ms;
+    app->idle_source_id = g_timeout_add(interval_ms, check_sensors, app);
+
+    return G_SOURCE_REMOVE;
+}
+
+static gboolean
+check_sensors(gpointer user_data)
+{
+    GestureSensors *app = (GestureSensors *)user_data;
+
+    // Without the module the screen state is unknown and nothing could wake
+    // it anyway, treat it as on so polling stops until the next idle
+    gboolean current_screen_on = !load_wake_module(app) || app->wake->screen_on();
+    if (current_screen_on != app->previous_screen_on) {
+        trace_append(app, TRACE_RECORD_SCREEN, 0, current_screen_on, 0, 0);
+        app->previous_screen_on = current_screen_on;
+    }
+
+    if (current_screen_on) {
+        g_debug("Screen is on, stopping sensor checks");
+        unlock_wake_path(app);
+        return apply_poll_actions(app, wake_machine_screen(&app->machine, TRUE));
+    }
+
+    if (app->machine.state != WAKE_MACHINE_ARMED) {
+        app->idle_source_id = 0;
+        return G_SOURCE_REMOVE;
+    }
+
+    // Hub subscribers keep both sensors polled even when the settings leave
+    // them out of the wake path
+    gboolean tilt_wanted = wake_machine_polls_tilt(&app->machine);
+    struct wake_machine_reading reading = {0};
+
+    if (wake_machine_polls_wake(&app->machine) && app->wake_session_id != -1) {
+        guint64 timestamp = 0;
+        reading.wake = get_wake_sensor_reading(&app->sensorfw, &timestamp);
+        reading.wake_timestamp = timestamp;
+        trace_append(app, TRACE_RECORD_WAKE, timestamp, reading.wake, 0, 0);
+    }
+
+    if (tilt_wanted && app->tilt_session_id != -1) {
+        guint64 timestamp = 0;
+        reading.tilt = get_tilt_source_reading(app, &timestamp);
+        reading.tilt_timestamp = timestamp;
+    }
+
+    // Screen stays off on a veto, the latched gesture is cleared and
+    // polling carries on
+    unsigned int actions = wake_machine_reading(&app->machine, &reading);
+    if ((actions & WAKE_MACHINE_WAKE) && wake_blocked_by_proximity(app))
+        actions = wake_machine_blocked(&app->machine, actions);
+
+    if (actions & WAKE_MACHINE_WAKE) {
+        guint sources = 0;
+        if ((actions & WAKE_MACHINE_EMIT_WAKE) && app->machine.wake_enabled)
+            sources |= WAKE_SOURCE_BIT(WAKE_SOURCE_WAKE);
+        if ((actions & WAKE_MACHINE_EMIT_TILT) && app->machine.tilt_enabled)
+            sources |= WAKE_SOURCE_BIT(WAKE_SOURCE_TILT);
+        wake_stats_woke(&app->wake_stats, sources, g_get_monotonic_time());
+    }
+
+    if (apply_poll_actions(app, actions) == G_SOURCE_REMOVE)
+        return G_SOURCE_REMOVE;
+
+    // A recording samples accel at the local engine's rate either way, or
+    // replay would compare the engines on a 2 Hz stream
+    gboolean accel_rate = tilt_wanted && (app->local_engine || app->recording);
+    gulong interval_us = accel_rate ? ACCEL_POLL_INTERVAL_US : SENSOR_POLL_INTERVAL_US;
+    if (battery_saving(app))
+        interval_us *= LOW_BATTERY_POLL_FACTOR;
+
+    return schedule_poll(app, interval_us / 1000);
+}
+
+static guint
+get_arm_debounce_ms(GestureSensors *app)
+{
+    return app->settings ? g_settings_get_uint(app->settings, "arm-debounce-ms") : ARM_DEBOUNCE_DEFAULT_MS;
+}
+
+static guint
+get_wake_dedup_ms(GestureSensors *app)
+{
+    return app->settings ? g_settings_get_uint(app->settings, "wake-dedup-ms") : WAKE_DEDUP_DEFAULT_MS;
+}
+
+static void
+get_machine_config(GestureSensors *app, struct wake_machine_config *config)
+{
+    config->debounce_us = (guint64)get_arm_debounce_ms(app) * 1000;
+    config->dedup_us = (guint64)get_wake_dedup_ms(app) * 1000;
+}
+
+static gboolean
+arm_sensors(gpointer user_data)
+{
+    GestureSensors *app = (GestureSensors *)user_data;
+
+    app->arm_timeout_id = 0;
+
+    g_debug("Idle settled, releasing and requesting sensors");
+    apply_actions(app, wake_machine_arm_timer(&app->machine, g_get_monotonic_time()));
+
+    return G_SOURCE_REMOVE;
+}
+
+static void update_machine(GestureSensors *app);
+
+static gboolean
+resume_tilt(gpointer user_data)
+{
+    GestureSensors *app = (GestureSensors *)user_data;
+
+    app->tilt_resume_source_id = 0;
+    g_debug("Tilt wake pause is over");
+    update_machine(app);
+
+    return G_SOURCE_REMOVE;
+}
+
+// Settings and hub subscribers decide what the machine wants, the logind
+// hints, output power, suspend, readings and input keys then drive it
+static void
+update_machine(GestureSensors *app)
+{
+    gboolean listening = gesture_hub_subscribers(&app->hub) > 0;
+    gboolean tilt_enabled = g_settings_get_boolean(app->settings, "tilt-sensor-enabled");
+
+    if (tilt_enabled && battery_saving(app)) {
+        g_debug("Battery low, tilt does not wake");
+        tilt_enabled = FALSE;
+    }
+
+    gint64 paused_us = wake_stats_tilt_paused_for(&app->wake_stats, g_get_monotonic_time());
+    if (tilt_enabled && paused_us > 0) {
+        tilt_enabled = FALSE;
+        if (app->tilt_resume_source_id == 0)
+            app->tilt_resume_source_id = g_timeout_add_seconds((paused_us + G_USEC_PER_SEC - 1) / G_USEC_PER_SEC,
+                                                               resume_tilt, app);
+    }
+
+    get_machine_config(app, &app->machine.config);
+    apply_actions(app, wake_machine_settings(&app->machine,
+                                             g_settings_get_boolean(app->settings, "wake-sensor-enabled"),
+                                             tilt_enabled,
+                                             listening,
+                                             g_get_monotonic_time()));
+}
+
+static void
+set_sensor_standby_override(GestureSensors *app,
+                            const gchar *object_path,
+                            const gchar *interface,
+                            gint32 session_id)
+{
+    GVariant *result;
+    GError *error = NULL;
+    gboolean accepted = FALSE;
+
+    result = sensorfw_call(&app->sensorfw,
+                           object_path,
+                           interface,
+                           "setStandbyOverride",
+                           g_variant_new("(ib)", session_id, TRUE),
+                           G_VARIANT_TYPE("(b)"),
+                           &error);
 
     if (error) {
-        g_warning("Failed to release tilt sensor: %s", error->message);
+        g_warning("Failed to set standby override on %s: %s", object_path, error->message);
         g_error_free(error);
+        return;
     }
 
-    if (result)
-        g_variant_unref(result);
+    g_variant_get(result, "(b)", &accepted);
+    g_variant_unref(result);
+
+    if (!accepted)
+        g_debug("%s cannot stay active through suspend", object_path);
 }
 
-guint32
-get_tilt_sensor_reading(GestureSensors *app)
+static void
+take_sleep_inhibitor(GestureSensors *app)
 {
     GVariant *result;
     GError *error = NULL;
-    guint32 tilt_detected = 0;
-    result = g_dbus_connection_call_sync(app->dbus_connection,
-                                         "com.nokia.SensorService",
-                                         "/SensorManager/tiltdetectorsensor",
-                                         "org.freedesktop.DBus.Properties",
-                                         "Get",
-                                         g_variant_new("(ss)", "local.TiltDetectorSensor", "tiltdetector"),
-                                         G_VARIANT_TYPE("(v)"),
-                                         G_DBUS_CALL_FLAGS_NONE,
-                                         -1,
-                                         NULL,
-                                         &error);
+    GUnixFDList *fd_list = NULL;
+    gint32 index;
+
+    if (app->sleep_inhibit_fd >= 0)
+        return;
+
+    result = g_dbus_connection_call_with_unix_fd_list_sync(app->dbus_connection,
+                                                           "org.freedesktop.login1",
+                                                           "/org/freedesktop/login1",
+                                                           "org.freedesktop.login1.Manager",
+                                                           "Inhibit",
+                                                           g_variant_new("(ssss)",
+                                                                         "sleep",
+                                                                         "gesture-sensors",
+                                                                         "Arming gesture sensors for suspend",
+                                                                         "delay"),
+                                                           G_VARIANT_TYPE("(h)"),
+                                                           G_DBUS_CALL_FLAGS_NONE,
+                                                           -1,
+                                                           NULL,
+                                                           &fd_list,
+                                                           NULL,
+                                                           &error);
+
     if (error) {
-        g_warning("Failed to get tilt sensor reading: %s", error->message);
+        g_warning("Failed to take sleep inhibitor: %s", error->message);
         g_error_free(error);
-        return 0;
+        return;
     }
 
-    GVariant *value;
-    g_variant_get(result, "(v)", &value);
-    g_variant_get(value, "(tu)", NULL, &tilt_detected);
+    g_variant_get(result, "(h)", &index);
+    app->sleep_inhibit_fd = g_unix_fd_list_get(fd_list, index, &error);
+    if (error) {
+        g_warning("Failed to get sleep inhibitor fd: %s", error->message);
+        g_error_free(error);
+    }
 
-    g_variant_unref(value);
+    g_object_unref(fd_list);
     g_variant_unref(result);
+}
 
-    return tilt_detected;
+static void
+release_sleep_inhibitor(GestureSensors *app)
+{
+    if (app->sleep_inhibit_fd >= 0)
+        close(app->sleep_inhibit_fd);
+    app->sleep_inhibit_fd = -1;
 }
 
-static gchar*
-get_session_id(GestureSensors *app)
+// Polling freezes with the AP, so the sensors are left armed and running
+// under a standby override and the latched gesture is what wakes the device.
+// The local engine needs the AP to see accelerometer samples and so only
+// catches up after resume.
+static void
+set_standby_overrides(GestureSensors *app)
 {
-    GVariant *result;
-    GError *error = NULL;
-    gchar *session_id = NULL;
+    gboolean wake_enabled = wake_machine_polls_wake(&app->machine);
+    gboolean tilt_enabled = wake_machine_polls_tilt(&app->machine);
+
+    if (wake_enabled && app->wake_session_id != -1)
+        set_sensor_standby_override(app, "/SensorManager/wakegesturesensor",
+                                    "local.WakeGestureSensor", app->wake_session_id);
+    if (tilt_enabled && !app->local_engine && app->tilt_session_id != -1)
+        set_sensor_standby_override(app, "/SensorManager/tiltdetectorsensor",
+                                    "local.TiltDetectorSensor", app->tilt_session_id);
+}
 
-    result = g_dbus_connection_call_sync(app->dbus_connection,
-                                         "org.freedesktop.login1",
-                                         "/org/freedesktop/login1",
-                                         "org.freedesktop.login1.Manager",
-                                         "ListSessions",
-                                         NULL,
-                                         G_VARIANT_TYPE("(a(susso))"),
-                                         G_DBUS_CALL_FLAGS_NONE,
-                                         -1,
-                                         NULL,
-                                         &error);
+static void
+on_prepare_for_sleep(GDBusConnection *connection,
+                     const gchar *sender_name,
+                     const gchar *object_path,
+                     const gchar *interface_name,
+                     const gchar *signal_name,
+                     GVariant *parameters,
+                     gpointer user_data)
+{
+    GestureSensors *app = (GestureSensors *)user_data;
+    gboolean sleeping;
+
+    g_variant_get(parameters, "(b)", &sleeping);
 
-    if (error) {
-        g_warning("Failed to list sessions: %s", error->message);
-        g_error_free(error);
-        return NULL;
+    if (sleeping) {
+        g_debug("Preparing for suspend");
+        apply_actions(app, wake_machine_sleep(&app->machine, TRUE));
+        release_sleep_inhibitor(app);
+        return;
     }
 
-    GVariantIter *iter;
-    gchar *id, *seat, *path;
+    g_debug("Resumed from suspend");
+    take_sleep_inhibitor(app);
 
-    g_variant_get(result, "(a(susso))", &iter);
-    while (g_variant_iter_loop(iter, "(susso)", &id, NULL, NULL, &seat, &path)) {
-        if (g_strcmp0(seat, "seat0") == 0) {
-            session_id = g_strdup(id);
-            break;
-        }
+    // Sensors are still held from before suspend, pick up the latched
+    // gesture straight away instead of waiting for IdleHint
+    apply_actions(app, wake_machine_sleep(&app->machine, FALSE));
+}
+
+static void
+subscribe_to_sleep(GestureSensors *app)
+{
+    app->sleep_subscription_id = g_dbus_connection_signal_subscribe(app->dbus_connection,
+                                                                    "org.freedesktop.login1",
+                                                                    "org.freedesktop.login1.Manager",
+                                                                    "PrepareForSleep",
+                                                                    "/org/freedesktop/login1",
+                                                                    NULL,
+                                                                    G_DBUS_SIGNAL_FLAGS_NONE,
+                                                                    on_prepare_for_sleep,
+                                                                    app,
+                                                                    NULL);
+
+    take_sleep_inhibitor(app);
+}
+
+static gint64
+false_wake_window_us(GestureSensors *app)
+{
+    return (gint64)g_settings_get_uint(app->settings, "false-wake-window-s") * G_USEC_PER_SEC;
+}
+
+static void
+report_outcome(GestureSensors *app, const WakeOutcome *outcome, guint limit)
+{
+    trace_append(app, TRACE_RECORD_WAKE_OUTCOME, 0, outcome->sources, outcome->false_wake, outcome->tilt_pause_s);
+    if (outcome->false_wake)
+        g_debug("Wake was not used");
+
+    if (outcome->tilt_pause_s > 0) {
+        g_message("%u tilt wakes in a row went unused, pausing tilt wake for %u min",
+                  limit, outcome->tilt_pause_s / 60);
+        update_machine(app);
     }
+}
 
-    g_variant_iter_free(iter);
-    g_variant_unref(result);
+// Input or an unlock after a wake means it was wanted, whenever the screen
+// goes off later. IdleHint clearing right after the wake is the wake's own.
+static void
+note_activity(GestureSensors *app, gint64 grace_us)
+{
+    WakeOutcome outcome;
+    guint limit = g_settings_get_uint(app->settings, "false-wake-limit");
 
-    return session_id;
+    if (false_wake_window_us(app) <= 0 ||
+        !wake_stats_activity(&app->wake_stats, g_get_monotonic_time(), grace_us, limit, &outcome))
+        return;
+
+    report_outcome(app, &outcome, limit);
 }
 
+// Idle coming back soon after a wake with no activity in between means
+// nobody used the screen. Enough of those in a row from tilt pause tilt
+// wake before the sensors re-arm.
 static void
-handle_wake_gesture(GestureSensors *app)
+settle_wake(GestureSensors *app)
 {
-    GError *error = NULL;
+    WakeOutcome outcome;
+    guint limit = g_settings_get_uint(app->settings, "false-wake-limit");
 
-    g_dbus_connection_call_sync(app->dbus_connection,
-                                "com.nokia.SensorService",
-                                "/SensorManager/wakegesturesensor",
-                                "local.WakeGestureSensor",
-                                "resetWakeGesture",
-                                NULL,
-                                NULL,
-                                G_DBUS_CALL_FLAGS_NONE,
-                                -1,
-                                NULL,
-                                &error);
-
-    g_dbus_connection_call_sync(app->dbus_connection,
-                                "com.nokia.SensorService",
-                                "/SensorManager/tiltdetectorsensor",
-                                "local.TiltDetectorSensor",
-                                "resetTiltDetector",
-                                NULL,
-                                NULL,
-                                G_DBUS_CALL_FLAGS_NONE,
-                                -1,
-                                NULL,
-                                &error);
-    if (error) {
-        g_warning("Failed to reset sensors: %s", error->message);
-        g_error_free(error);
-    }
+    if (!wake_stats_settle(&app->wake_stats, g_get_monotonic_time(), false_wake_window_us(app), limit,
+                           &outcome))
+        return;
 
-    release_wake_sensor(app, app->wake_session_id);
-    release_tilt_sensor(app, app->tilt_session_id);
-    app->wake_session_id = request_wake_sensor(app);
-    app->tilt_session_id = request_tilt_sensor(app);
-    if (app->wake_session_id == -1 || app->tilt_session_id == -1) {
-        g_printerr("Failed to request new sensors after reset\n");
-        g_main_loop_quit(app->main_loop);
+    report_outcome(app, &outcome, limit);
+}
+
+// Starts the uncovered window measured by TRACE_RECORD_ARM_GAP. Only
+// counted when something is going to arm.
+static void
+note_blank(GestureSensors *app, enum trace_arm_trigger trigger)
+{
+    if (app->blanked_at || app->machine.state == WAKE_MACHINE_ARMED)
+        return;
+    if (!wake_machine_polls_wake(&app->machine) && !wake_machine_polls_tilt(&app->machine))
         return;
-    }
 
-    send_wake_key();
+    app->blanked_at = g_get_monotonic_time();
+    app->blank_trigger = trigger;
 }
 
-static gboolean
-check_sensors(gpointer user_data)
+// Output power is the earliest sign of a blank and, unlike IdleHint, the
+// moment the screen actually goes dark, so it arms without the debounce.
+// Turning back on ends the arm the same way IdleHint going false does.
+static void
+on_display_changed(gpointer user_data)
 {
     GestureSensors *app = (GestureSensors *)user_data;
+    gboolean screen_on = !app->display.off;
 
-    int result = wlrdisplay(0, NULL);
-    gboolean current_screen_on = (result == 0);
-    if (current_screen_on) {
-        g_debug("Screen is on, stopping sensor checks");
-        app->idle_source_id = 0;
-        return G_SOURCE_REMOVE;
-    }
-
-    gboolean wake_enabled = g_settings_get_boolean(app->settings, "wake-sensor-enabled");
-    gboolean tilt_enabled = g_settings_get_boolean(app->settings, "tilt-sensor-enabled");
-    if (!wake_enabled && !tilt_enabled) {
-        g_debug("All sensors disabled, stopping checks");
-        app->idle_source_id = 0;
-        return G_SOURCE_REMOVE;
+    if (screen_on != app->previous_screen_on) {
+        trace_append(app, TRACE_RECORD_SCREEN, 0, screen_on, 0, 0);
+        app->previous_screen_on = screen_on;
     }
 
-    guint32 wake_reading = wake_enabled ? get_wake_sensor_reading(app) : 0;
-    guint32 tilt_reading = tilt_enabled ? get_tilt_sensor_reading(app) : 0;
-    if (wake_reading == 1 || tilt_reading == 1) {
-        g_debug("Wake gesture or tilt detected! Wake: %u, Tilt: %u", wake_reading, tilt_reading);
-        handle_wake_gesture(app);
-        app->idle_source_id = 0;
-        return G_SOURCE_REMOVE;
+    if (screen_on) {
+        if (app->wake)
+            app->wake->confirm(&app->wake_action);
+        app->blanked_at = 0;
+        apply_actions(app, wake_machine_idle(&app->machine, FALSE, g_get_monotonic_time()));
+        apply_actions(app, wake_machine_screen(&app->machine, TRUE));
+        unlock_wake_path(app);
+        return;
     }
 
-    g_usleep(500000);
-
-    return G_SOURCE_CONTINUE;
+    settle_wake(app);
+    note_blank(app, TRACE_ARM_TRIGGER_OUTPUT_OFF);
+    apply_actions(app, wake_machine_blank(&app->machine));
+    lock_wake_path(app);
 }
 
 static void
@@ -575,37 +1272,104 @@ on_idle_hint_changed(GDBusConnection *connection,
     if (idle_variant) {
         gboolean idle = g_variant_get_boolean(idle_variant);
         g_debug("IdleHint changed: %d", idle);
+        trace_append(app, TRACE_RECORD_IDLE_HINT, 0, idle, 0, 0);
+        if (idle) {
+            settle_wake(app);
+            // Stands in for the screen off time when outputs are not visible
+            if (!app->display.available)
+                note_blank(app, TRACE_ARM_TRIGGER_IDLE_HINT);
+        } else {
+            app->blanked_at = 0;
+            note_activity(app, WAKE_ACTIVITY_GRACE_US);
+        }
+        apply_actions(app, wake_machine_idle(&app->machine, idle, g_get_monotonic_time()));
+        if (idle)
+            lock_wake_path(app);
+        else
+            unlock_wake_path(app);
 
-        gboolean wake_enabled = g_settings_get_boolean(app->settings, "wake-sensor-enabled");
-        gboolean tilt_enabled = g_settings_get_boolean(app->settings, "tilt-sensor-enabled");
-
-        if (idle && app->idle_source_id == 0 && (wake_enabled || tilt_enabled)) {
-            g_debug("Screen turned off, releasing and requesting sensors");
-            release_wake_sensor(app, app->wake_session_id);
-            release_tilt_sensor(app, app->tilt_session_id);
-            app->wake_session_id = request_wake_sensor(app);
-            app->tilt_session_id = request_tilt_sensor(app);
-            if (app->wake_session_id == -1 || app->tilt_session_id == -1) {
-                g_printerr("Failed to request new sensors after reset\n");
-                g_main_loop_quit(app->main_loop);
-                return;
-            }
+        g_variant_unref(idle_variant);
+    }
 
-            g_debug("System went idle, starting sensor checks");
-            app->idle_source_id = g_idle_add(check_sensors, app);
+    // The lock screen mostly comes up just ahead of the blank, sessions are
+    // requested then so the arm only has to start polling. Unlocking means
+    // someone is using the phone.
+    GVariant *locked_variant = g_variant_lookup_value(changed_properties, "LockedHint", G_VARIANT_TYPE_BOOLEAN);
+    if (locked_variant) {
+        gboolean locked = g_variant_get_boolean(locked_variant);
+        g_debug("LockedHint changed: %d", locked);
+        if (locked) {
+            apply_actions(app, wake_machine_prepare(&app->machine));
+        } else {
+            app->blanked_at = 0;
+            note_activity(app, 0);
+            apply_actions(app, wake_machine_idle(&app->machine, FALSE, g_get_monotonic_time()));
+            unlock_wake_path(app);
         }
 
-        g_variant_unref(idle_variant);
+        g_variant_unref(locked_variant);
     }
 
     g_variant_unref(changed_properties);
     g_variant_unref(invalidated_properties);
 }
 
+static gboolean
+features_in_use(GestureSensors *app)
+{
+    return g_settings_get_boolean(app->settings, "wake-sensor-enabled") ||
+           g_settings_get_boolean(app->settings, "tilt-sensor-enabled") ||
+           g_settings_get_boolean(app->settings, "input-wake-enabled") ||
+           g_settings_get_boolean(app->settings, "palm-rejection-supported") ||
+           g_settings_get_boolean(app->settings, "glove-mode-supported") ||
+           gesture_hub_subscribers(&app->hub) > 0;
+}
+
+static gboolean
+exit_if_unused(gpointer user_data)
+{
+    GestureSensors *app = (GestureSensors *)user_data;
+
+    app->exit_source_id = 0;
+    if (features_in_use(app))
+        return G_SOURCE_REMOVE;
+
+    g_message("No gesture feature enabled, exiting");
+    g_main_loop_quit(app->main_loop);
+
+    return G_SOURCE_REMOVE;
+}
+
+// Nothing to do means nothing to hold: the daemon exits and is started again
+// at the next login or through D-Bus activation of io.furios.Gesture, which
+// settings panels trigger after turning a feature on. The grace period lets
+// an activating call land and keeps a quick off/on toggle from restarting
+// the process.
+static void
+schedule_exit_check(GestureSensors *app)
+{
+    if (app->exit_source_id > 0)
+        g_source_remove(app->exit_source_id);
+
+    app->exit_source_id = g_timeout_add_seconds(UNUSED_EXIT_GRACE_S, exit_if_unused, app);
+}
+
+// A first subscriber arriving while idle arms the sensors even if the wake
+// path has them disabled, the last one leaving stops them if nothing else
+// wants them
+static void
+on_hub_subscribers_changed(guint subscribers, gpointer user_data)
+{
+    GestureSensors *app = (GestureSensors *)user_data;
+
+    update_machine(app);
+    if (subscribers == 0)
+        schedule_exit_check(app);
+}
+
 static void
 subscribe_to_idle_hint(GestureSensors *app)
 {
-    GError *error = NULL;
     gchar *session_path;
 
     while (!app->logind_session_id) {
@@ -619,18 +1383,25 @@ subscribe_to_idle_hint(GestureSensors *app)
 
     session_path = g_strdup_printf("/org/freedesktop/login1/session/%s", app->logind_session_id);
 
+    // logind only implements the one interface on the session object, so
+    // the arg0 match documents what the handler expects rather than saving
+    // wakeups. IdleHint and LockedHint cannot be matched inside the dict,
+    // the handler picks them out of every change to the session.
     app->subscription_id = g_dbus_connection_signal_subscribe(app->dbus_connection,
                                                               "org.freedesktop.login1",
                                                               "org.freedesktop.DBus.Properties",
                                                               "PropertiesChanged",
                                                               session_path,
-                                                              NULL,
+                                                              "org.freedesktop.login1.Session",
                                                               G_DBUS_SIGNAL_FLAGS_NONE,
                                                               on_idle_hint_changed,
                                                               app,
                                                               NULL);
 
-    g_debug("Listening for IdleHint changes on session %s", app->logind_session_id);
+    if (app->wake)
+        app->wake->set_session(&app->wake_action, app->logind_session_id);
+
+    g_debug("Listening for IdleHint and LockedHint changes on session %s", app->logind_session_id);
     g_free(session_path);
 }
 
@@ -654,6 +1425,109 @@ on_glove_mode_changed(GSettings *settings,
     write_to_file(GLOVE_MODE_PATH, enabled ? "1" : "0");
 }
 
+static void
+on_wake_backend_changed(GSettings *settings,
+                        const gchar *key,
+                        gpointer user_data)
+{
+    GestureSensors *app = (GestureSensors *)user_data;
+    gchar *backend = g_settings_get_string(settings, "wake-backend");
+    g_debug("Wake backend set to %s", backend);
+    if (app->wake)
+        app->wake->set_backend(&app->wake_action, backend);
+    g_free(backend);
+}
+
+static void
+on_wake_boost_changed(GSettings *settings,
+                      const gchar *key,
+                      gpointer user_data)
+{
+    GestureSensors *app = (GestureSensors *)user_data;
+    gchar *mode = g_settings_get_string(settings, "wake-boost");
+
+    wake_boost_set_mode(&app->boost, mode);
+    app->boost.nice = g_settings_get_int(settings, "wake-boost-nice");
+    app->boost.fifo_priority = g_settings_get_int(settings, "wake-boost-fifo-priority");
+    app->boost.uclamp_min = g_settings_get_int(settings, "wake-boost-uclamp-min");
+    app->boost.cpu = g_settings_get_int(settings, "wake-boost-cpu");
+    g_debug("Wake boost set to %s", mode);
+
+    g_free(mode);
+}
+
+// Takes effect the next time the session goes idle
+static void
+on_wake_resident_changed(GSettings *settings,
+                         const gchar *key,
+                         gpointer user_data)
+{
+    GestureSensors *app = (GestureSensors *)user_data;
+
+    unlock_wake_path(app);
+    app->resident.cap = (gsize)g_settings_get_uint(settings, "wake-resident-max-kb") * 1024;
+}
+
+static void
+on_feature_changed(GSettings *settings,
+                   const gchar *key,
+                   gpointer user_data)
+{
+    GestureSensors *app = (GestureSensors *)user_data;
+
+    if (!g_settings_get_boolean(settings, key))
+        schedule_exit_check(app);
+}
+
+static void
+on_power_changed(gpointer user_data)
+{
+    update_machine((GestureSensors *)user_data);
+}
+
+// A failed wake module load is tried again on the next use after any
+// settings change, e.g. toggling a wake feature after reinstalling it
+static void
+on_settings_changed(GSettings *settings,
+                    const gchar *key,
+                    gpointer user_data)
+{
+    GestureSensors *app = (GestureSensors *)user_data;
+
+    app->wake_module_failed = FALSE;
+}
+
+static void
+on_machine_settings_changed(GSettings *settings,
+                            const gchar *key,
+                            gpointer user_data)
+{
+    update_machine((GestureSensors *)user_data);
+}
+
+static void
+on_input_wake_changed(GSettings *settings,
+                      const gchar *key,
+                      gpointer user_data)
+{
+    GestureSensors *app = (GestureSensors *)user_data;
+
+    // Reopened on every change, the device setting may name another one
+    evdev_source_close(&app->evdev);
+    if (!g_settings_get_boolean(settings, "input-wake-enabled"))
+        return;
+
+    gchar *device = g_settings_get_string(settings, "input-wake-device");
+    gboolean opened = evdev_source_open(&app->evdev, device[0] ? device : NULL,
+                                        WAKE_ACTION_UINPUT_NAME, on_input_wake, app);
+    g_free(device);
+
+    if (!opened)
+        g_debug("No input device reports wake keys");
+    else
+        load_wake_module(app);
+}
+
 static void
 init_gsettings(GestureSensors *app)
 {
@@ -665,6 +1539,9 @@ init_gsettings(GestureSensors *app)
     g_settings_set_boolean(app->settings, "glove-mode-supported", glove_supported);
     g_debug("Glove mode %s", glove_supported ? "is supported" : "is not supported");
 
+    // Ahead of the per-key handlers, some of them load the wake module
+    g_signal_connect(app->settings, "changed", G_CALLBACK(on_settings_changed), app);
+
     if (palm_supported) {
         gboolean palm_rejection = g_settings_get_boolean(app->settings, "palm-rejection-enabled");
         write_to_file(PALM_REJECTION_PATH, palm_rejection ? "1" : "0");
@@ -678,21 +1555,397 @@ init_gsettings(GestureSensors *app)
         g_signal_connect(app->settings, "changed::glove-mode-enabled",
                          G_CALLBACK(on_glove_mode_changed), NULL);
     }
+
+    on_wake_backend_changed(app->settings, "wake-backend", app);
+    g_signal_connect(app->settings, "changed::wake-backend",
+                     G_CALLBACK(on_wake_backend_changed), app);
+
+    on_wake_boost_changed(app->settings, "wake-boost", app);
+    g_signal_connect(app->settings, "changed::wake-boost",
+                     G_CALLBACK(on_wake_boost_changed), app);
+    g_signal_connect(app->settings, "changed::wake-boost-nice",
+                     G_CALLBACK(on_wake_boost_changed), app);
+    g_signal_connect(app->settings, "changed::wake-boost-fifo-priority",
+                     G_CALLBACK(on_wake_boost_changed), app);
+    g_signal_connect(app->settings, "changed::wake-boost-uclamp-min",
+                     G_CALLBACK(on_wake_boost_changed), app);
+    g_signal_connect(app->settings, "changed::wake-boost-cpu",
+                     G_CALLBACK(on_wake_boost_changed), app);
+
+    on_wake_resident_changed(app->settings, "wake-resident-max-kb", app);
+    g_signal_connect(app->settings, "changed::wake-resident-max-kb",
+                     G_CALLBACK(on_wake_resident_changed), app);
+
+    on_input_wake_changed(app->settings, "input-wake-enabled", app);
+    g_signal_connect(app->settings, "changed::input-wake-enabled",
+                     G_CALLBACK(on_input_wake_changed), app);
+    g_signal_connect(app->settings, "changed::input-wake-device",
+                     G_CALLBACK(on_input_wake_changed), app);
+
+    g_signal_connect(app->settings, "changed::wake-sensor-enabled",
+                     G_CALLBACK(on_feature_changed), app);
+    g_signal_connect(app->settings, "changed::tilt-sensor-enabled",
+                     G_CALLBACK(on_feature_changed), app);
+    g_signal_connect(app->settings, "changed::input-wake-enabled",
+                     G_CALLBACK(on_feature_changed), app);
+
+    update_machine(app);
+    g_signal_connect(app->settings, "changed::wake-sensor-enabled",
+                     G_CALLBACK(on_machine_settings_changed), app);
+    g_signal_connect(app->settings, "changed::tilt-sensor-enabled",
+                     G_CALLBACK(on_machine_settings_changed), app);
+    g_signal_connect(app->settings, "changed::arm-debounce-ms",
+                     G_CALLBACK(on_machine_settings_changed), app);
+    g_signal_connect(app->settings, "changed::wake-dedup-ms",
+                     G_CALLBACK(on_machine_settings_changed), app);
+    g_signal_connect(app->settings, "changed::low-battery-percentage",
+                     G_CALLBACK(on_machine_settings_changed), app);
+    g_signal_connect(app->settings, "changed::low-battery-disable-tilt",
+                     G_CALLBACK(on_machine_settings_changed), app);
+}
+
+typedef struct {
+    gboolean plugin_armed;
+    gboolean local_armed;
+    guint64 plugin_at;
+    guint64 local_at;
+    guint cycles;
+    guint plugin_wakes;
+    guint local_wakes;
+    guint wake_paths[2];
+    gint64 wake_path_total[2];
+    guint paired;
+    gint64 delta_total;
+    gint64 delta_max;
+    guint machine_wakes;
+    guint backend_runs;
+    guint backend_ok;
+    gint64 backend_wall_total;
+    gint64 backend_cpu_total;
+} ReplayStats;
+
+static void
+replay_finish_cycle(ReplayStats *stats)
+{
+    if (stats->plugin_at && stats->local_at) {
+        gint64 delta = (gint64)stats->local_at - (gint64)stats->plugin_at;
+        stats->paired++;
+        stats->delta_total += delta;
+        if (ABS(delta) > ABS(stats->delta_max))
+            stats->delta_max = delta;
+    }
+
+    stats->plugin_armed = FALSE;
+    stats->local_armed = FALSE;
+    stats->plugin_at = 0;
+    stats->local_at = 0;
+}
+
+// Both engines are replayed, so every arm holds the wake, tilt and
+// accelerometer sessions
+static void
+replay_arm(GestureSensors *app, ReplayStats *stats, unsigned int actions)
+{
+    if (!(actions & WAKE_MACHINE_ACQUIRE))
+        return;
+
+    stats->plugin_armed = TRUE;
+    stats->local_armed = TRUE;
+    stats->cycles++;
+    accel_gesture_reset(&app->accel);
+
+    if (replay_sensorfw) {
+        release_sensors(app);
+        app->wake_session_id = request_wake_sensor(&app->sensorfw);
+        app->tilt_session_id = request_tilt_sensor(&app->sensorfw);
+        app->trace_accel_session_id = request_accel_sensor(&app->sensorfw);
+    }
+}
+
+// With --replay-sensorfw each reading is fetched through sensorfw as the
+// live poll would, from the stand-in when training a release build. The
+// trace's value is still the one replayed, so the figures do not change.
+static void
+replay_fetch(GestureSensors *app, guint32 type)
+{
+    struct accel_sample sample;
+    guint64 timestamp;
+
+    if (!replay_sensorfw)
+        return;
+
+    if (type == TRACE_RECORD_WAKE && app->wake_session_id != -1)
+        get_wake_sensor_reading(&app->sensorfw, &timestamp);
+    else if (type == TRACE_RECORD_TILT && app->tilt_session_id != -1)
+        get_tilt_sensor_reading(&app->sensorfw, &timestamp);
+    else if (type == TRACE_RECORD_ACCEL && app->trace_accel_session_id != -1)
+        get_accel_sensor_reading(&app->sensorfw, &sample);
+}
+
+static gint64
+cpu_time_us(void)
+{
+    struct rusage usage;
+
+    getrusage(RUSAGE_SELF, &usage);
+    return (gint64)(usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) * G_USEC_PER_SEC +
+           usage.ru_utime.tv_usec + usage.ru_stime.tv_usec;
+}
+
+// Latches go through the same decision as in check_sensors(). With
+// --replay-wake the backends then run for real, on a desk the screen is
+// already on, so their cost is measured without a wake to show for it.
+static void
+replay_reading(GestureSensors *app, ReplayStats *stats, const struct trace_record *record)
+{
+    struct wake_machine_reading reading = {0};
+
+    if (record->type == TRACE_RECORD_WAKE) {
+        reading.wake = record->value[0];
+        reading.wake_timestamp = record->timestamp;
+    } else {
+        reading.tilt = record->value[0];
+        reading.tilt_timestamp = record->timestamp;
+    }
+
+    if (!(wake_machine_reading(&app->machine, &reading) & WAKE_MACHINE_WAKE))
+        return;
+
+    stats->machine_wakes++;
+    if (!replay_wake)
+        return;
+
+    gint64 started = g_get_monotonic_time();
+    gint64 cpu_started = cpu_time_us();
+    // Nothing reports the screen on during a replay
+    if (app->wake->run(&app->wake_action, FALSE))
+        stats->backend_ok++;
+    stats->backend_cpu_total += cpu_time_us() - cpu_started;
+    stats->backend_wall_total += g_get_monotonic_time() - started;
+    stats->backend_runs++;
+}
+
+// Feeds a trace through the wake machine the live daemon runs, on the
+// trace's own clock and without sleeping. The machine decides when a cycle
+// arms and ends, detection is tracked per path: plugin tilt readings and raw
+// accelerometer samples are kept apart so the local engine can be compared
+// against tiltdetectorsensor on one recording.
+static int
+run_replay(GestureSensors *app, const gchar *path)
+{
+    struct trace_reader reader;
+    ReplayStats stats = {0};
+    struct accel_sample sample;
+
+    if (trace_reader_open(&reader, path) < 0) {
+        g_printerr("Failed to open trace %s: %s\n", path, g_strerror(errno));
+        return 1;
+    }
+
+    if (replay_sensorfw) {
+        GError *error = NULL;
+
+        app->dbus_connection = g_bus_get_sync(G_BUS_TYPE_SYSTEM, NULL, &error);
+        if (!app->dbus_connection) {
+            g_printerr("--replay-sensorfw needs the system bus: %s\n", error->message);
+            g_error_free(error);
+            trace_reader_close(&reader);
+            return 1;
+        }
+        sensorfw_client_init(&app->sensorfw, app->dbus_connection, record_sensorfw_call, app);
+    }
+
+    // Loaded up front so the load is not billed to the first wake
+    if (replay_wake && !load_wake_module(app)) {
+        g_printerr("--replay-wake needs the wake module\n");
+        trace_reader_close(&reader);
+        return 1;
+    }
+
+    init_local_engine(app);
+
+    struct wake_machine_config config;
+    get_machine_config(app, &config);
+    wake_machine_init(&app->machine, &config);
+    wake_machine_settings(&app->machine, TRUE, TRUE, FALSE, 0);
+
+    gint64 started = g_get_monotonic_time();
+
+    for (gsize i = 0; i < reader.count; i++) {
+        const struct trace_record *record = &reader.records[i];
+
+        if (app->machine.state == WAKE_MACHINE_ARM_PENDING)
+            replay_arm(app, &stats, wake_machine_arm_timer(&app->machine, record->time));
+
+        switch (record->type) {
+        case TRACE_RECORD_IDLE_HINT:
+            replay_arm(app, &stats, wake_machine_idle(&app->machine, record->value[0], record->time));
+            if (!record->value[0])
+                replay_finish_cycle(&stats);
+            break;
+        case TRACE_RECORD_SCREEN:
+            if (record->value[0]) {
+                wake_machine_screen(&app->machine, TRUE);
+                replay_finish_cycle(&stats);
+            }
+            break;
+        case TRACE_RECORD_WAKE:
+            replay_fetch(app, record->type);
+            // The wake gesture sensor is shared by both paths
+            if (record->value[0] != 1)
+                break;
+            if (stats.plugin_armed) {
+                stats.plugin_armed = FALSE;
+                stats.plugin_at = record->time;
+                stats.plugin_wakes++;
+            }
+            if (stats.local_armed) {
+                stats.local_armed = FALSE;
+                stats.local_at = record->time;
+                stats.local_wakes++;
+            }
+            replay_reading(app, &stats, record);
+            break;
+        case TRACE_RECORD_TILT:
+            replay_fetch(app, record->type);
+            if (stats.plugin_armed && record->value[0] == 1) {
+                stats.plugin_armed = FALSE;
+                stats.plugin_at = record->time;
+                stats.plugin_wakes++;
+            }
+            replay_reading(app, &stats, record);
+            break;
+        case TRACE_RECORD_PROXIMITY:
+            // Gating happens after detection, it does not change latency
+            break;
+        case TRACE_RECORD_INPUT:
+            // Input wakes bypass both gesture engines
+            break;
+        case TRACE_RECORD_WAKE_ACTION:
+        case TRACE_RECORD_SYSFS_WRITE:
+        case TRACE_RECORD_ARM:
+        case TRACE_RECORD_STARTUP:
+        case TRACE_RECORD_SENSORFW:
+        case TRACE_RECORD_WAKE_OUTCOME:
+        case TRACE_RECORD_RESIDENT:
+        case TRACE_RECORD_WAKE_MODULE:
+        case TRACE_RECORD_ARM_GAP:
+            // Flight recorder only
+            break;
+        case TRACE_RECORD_WAKE_PATH: {
+            guint boosted = record->value[1] ? 1 : 0;
+            stats.wake_paths[boosted]++;
+            stats.wake_path_total[boosted] += record->value[0];
+            break;
+        }
+        case TRACE_RECORD_ACCEL:
+            replay_fetch(app, record->type);
+            if (!stats.local_armed)
+                break;
+            sample.timestamp = record->timestamp;
+            sample.x = record->value[0];
+            sample.y = record->value[1];
+            sample.z = record->value[2];
+            if (feed_local_engine(app, &sample)) {
+                stats.local_armed = FALSE;
+                stats.local_at = record->time;
+                stats.local_wakes++;
+            }
+            break;
+        default:
+            g_warning("Skipping unknown trace record type %u", record->type);
+            break;
+        }
+    }
+    replay_finish_cycle(&stats);
+
+    gint64 elapsed = g_get_monotonic_time() - started;
+    guint64 span = reader.count > 1 ? reader.records[reader.count - 1].time - reader.records[0].time : 0;
+
+    g_print("records: %zu\n", reader.count);
+    g_print("trace span: %.3f s, replayed in %.3f ms (%.0fx real time)\n",
+            span / 1e6, elapsed / 1e3, elapsed > 0 ? (double)span / elapsed : 0.0);
+    g_print("idle cycles: %u\n", stats.cycles);
+    g_print("plugin wakes: %u\n", stats.plugin_wakes);
+    g_print("local wakes: %u\n", stats.local_wakes);
+    if (stats.paired > 0)
+        g_print("local - plugin latency over %u cycles: mean %.1f ms, worst %.1f ms\n",
+                stats.paired, stats.delta_total / 1e3 / stats.paired, stats.delta_max / 1e3);
+    for (guint boosted = 0; boosted < 2; boosted++)
+        if (stats.wake_paths[boosted] > 0)
+            g_print("%s wake path over %u wakes: mean %.1f ms\n",
+                    boosted ? "boosted" : "unboosted", stats.wake_paths[boosted],
+                    stats.wake_path_total[boosted] / 1e3 / stats.wake_paths[boosted]);
+    g_print("wake machine wakes: %u\n", stats.machine_wakes);
+    if (stats.backend_runs > 0)
+        g_print("wake backends over %u wakes: %u sent, mean %.1f ms wall, %.2f ms CPU\n",
+                stats.backend_runs, stats.backend_ok,
+                stats.backend_wall_total / 1e3 / stats.backend_runs,
+                stats.backend_cpu_total / 1e3 / stats.backend_runs);
+
+    trace_reader_close(&reader);
+
+    return 0;
+}
+
+static GSettings *
+new_settings_if_installed(void)
+{
+    GSettingsSchemaSource *source = g_settings_schema_source_get_default();
+    GSettingsSchema *schema = source ? g_settings_schema_source_lookup(source, "io.furios.gesture", TRUE) : NULL;
+
+    if (!schema)
+        return NULL;
+
+    g_settings_schema_unref(schema);
+    return g_settings_new("io.furios.gesture");
 }
 
 static void
 cleanup_and_exit(GestureSensors *app)
 {
+    if (app->arm_timeout_id > 0) {
+        g_source_remove(app->arm_timeout_id);
+        app->arm_timeout_id = 0;
+    }
     if (app->idle_source_id > 0) {
         g_source_remove(app->idle_source_id);
         app->idle_source_id = 0;
     }
+    if (app->retry_source_id > 0) {
+        g_source_remove(app->retry_source_id);
+        app->retry_source_id = 0;
+    }
+    if (app->exit_source_id > 0) {
+        g_source_remove(app->exit_source_id);
+        app->exit_source_id = 0;
+    }
+    if (app->tilt_resume_source_id > 0) {
+        g_source_remove(app->tilt_resume_source_id);
+        app->tilt_resume_source_id = 0;
+    }
     if (app->subscription_id > 0)
         g_dbus_connection_signal_unsubscribe(app->dbus_connection, app->subscription_id);
-    if (app->wake_session_id != -1)
-        release_wake_sensor(app, app->wake_session_id);
-    if (app->tilt_session_id != -1)
-        release_tilt_sensor(app, app->tilt_session_id);
+    if (app->sleep_subscription_id > 0)
+        g_dbus_connection_signal_unsubscribe(app->dbus_connection, app->sleep_subscription_id);
+    release_sleep_inhibitor(app);
+    if (app->sensorfw_watch_id > 0)
+        g_bus_unwatch_name(app->sensorfw_watch_id);
+    evdev_source_close(&app->evdev);
+    gesture_hub_clear(&app->hub);
+    power_monitor_clear(&app->power);
+    display_monitor_clear(&app->display);
+    wake_stats_clear(&app->wake_stats);
+    wake_resident_unlock(&app->resident);
+    wake_boost_clear(&app->boost);
+    release_sensors(app);
+    sensorfw_client_clear(&app->sensorfw);
+    if (app->recording)
+        trace_writer_close(&app->trace);
+    if (app->wake)
+        app->wake->clear(&app->wake_action);
+    if (app->wake_module)
+        g_module_close(app->wake_module);
     if (app->dbus_connection)
         g_object_unref(app->dbus_connection);
     if (app->settings)
@@ -703,6 +1956,25 @@ cleanup_and_exit(GestureSensors *app)
         g_main_loop_quit(app->main_loop);
         g_main_loop_unref(app->main_loop);
     }
+
+    g_free(record_path);
+    g_free(replay_path);
+    record_path = NULL;
+    replay_path = NULL;
+}
+
+static gboolean
+on_dump_signal(gpointer user_data)
+{
+    gchar *path = g_build_filename(g_get_user_runtime_dir(), TRACE_LOG_DUMP_NAME, NULL);
+
+    if (trace_log_dump(path) < 0)
+        g_warning("Failed to dump event log to %s: %s", path, g_strerror(errno));
+    else
+        g_message("Event log dumped to %s", path);
+
+    g_free(path);
+    return G_SOURCE_CONTINUE;
 }
 
 static void
@@ -720,8 +1992,45 @@ signal_handler(int signum)
 int
 main(int argc, char *argv[])
 {
+    gint64 started = g_get_monotonic_time();
     GestureSensors app = {0};
     GError *error = NULL;
+    GOptionContext *context;
+
+    app.wake_session_id = -1;
+    app.tilt_session_id = -1;
+    app.trace_accel_session_id = -1;
+    app.proximity_session_id = -1;
+    app.sleep_inhibit_fd = -1;
+    evdev_source_init(&app.evdev);
+    wake_boost_init(&app.boost);
+    wake_resident_init(&app.resident);
+    app.trace.fd = -1;
+
+    context = g_option_context_new("- gesture sensors daemon");
+    g_option_context_add_main_entries(context, option_entries, NULL);
+    if (!g_option_context_parse(context, &argc, &argv, &error)) {
+        g_printerr("%s\n", error->message);
+        g_error_free(error);
+        g_option_context_free(context);
+        return 1;
+    }
+    g_option_context_free(context);
+
+    if (replay_path) {
+        app.settings = new_settings_if_installed();
+        int ret = run_replay(&app, replay_path);
+        cleanup_and_exit(&app);
+        return ret;
+    }
+
+    if (record_path) {
+        if (trace_writer_open(&app.trace, record_path) < 0) {
+            g_printerr("Failed to open trace %s: %s\n", record_path, g_strerror(errno));
+            return 1;
+        }
+        app.recording = TRUE;
+    }
 
     g_app = &app;
 
@@ -737,6 +2046,9 @@ main(int argc, char *argv[])
         return 1;
     }
 
+    // Dispatched from the main loop, dumping is not async-signal-safe
+    g_unix_signal_add(SIGUSR1, on_dump_signal, &app);
+
     app.dbus_connection = g_bus_get_sync(G_BUS_TYPE_SYSTEM, NULL, &error);
     if (!app.dbus_connection) {
         g_printerr("Failed to connect to D-Bus: %s\n", error->message);
@@ -744,6 +2056,15 @@ main(int argc, char *argv[])
         return 1;
     }
 
+    sensorfw_client_init(&app.sensorfw, app.dbus_connection, record_sensorfw_call, &app);
+    app.sensorfw_watch_id = g_bus_watch_name_on_connection(app.dbus_connection,
+                                                           SENSORFW_NAME,
+                                                           G_BUS_NAME_WATCHER_FLAGS_NONE,
+                                                           NULL,
+                                                           on_sensorfw_vanished,
+                                                           &app,
+                                                           NULL);
+
     app.settings = g_settings_new("io.furios.gesture");
     if (!app.settings) {
         g_printerr("Failed to create GSettings object\n");
@@ -751,19 +2072,62 @@ main(int argc, char *argv[])
         return 1;
     }
 
+    struct wake_machine_config config;
+    get_machine_config(&app, &config);
+    wake_machine_init(&app.machine, &config);
+    wake_stats_init(&app.wake_stats);
+
     init_gsettings(&app);
 
-    app.wake_session_id = request_wake_sensor(&app);
-    app.tilt_session_id = request_tilt_sensor(&app);
-    if (app.wake_session_id == -1 || app.tilt_session_id == -1) {
-        g_printerr("Failed to request sensors\n");
-        cleanup_and_exit(&app);
-        return 1;
+    if (!gesture_hub_init(&app.hub, on_hub_subscribers_changed, &app))
+        g_warning("Gesture hub unavailable, detections will only wake the screen");
+
+    power_monitor_init(&app.power, app.dbus_connection, on_power_changed, &app);
+
+    // Output power lives on the session bus, without it arming falls back
+    // to the logind hints
+    GDBusConnection *session_bus = g_bus_get_sync(G_BUS_TYPE_SESSION, NULL, &error);
+    if (session_bus) {
+        display_monitor_init(&app.display, session_bus, on_display_changed, &app);
+        g_object_unref(session_bus);
+    } else {
+        g_warning("No session bus, arming on logind hints only: %s", error->message);
+        g_clear_error(&error);
+    }
+
+    // Sensors are only worth holding up front when the wake path uses them,
+    // hub subscribers get them at the next arm
+    gboolean sensors_held = FALSE;
+    if (g_settings_get_boolean(app.settings, "wake-sensor-enabled") ||
+        g_settings_get_boolean(app.settings, "tilt-sensor-enabled")) {
+        probe_sensors(&app);
+        sensors_held = request_sensors(&app);
+        if (!sensors_held)
+            g_warning("No gesture sensors available yet, waiting for sensorfw");
+    } else {
+        app.wake_available = TRUE;
+        app.tilt_available = TRUE;
     }
 
+    if (early_wake_module)
+        load_wake_module(&app);
+
     subscribe_to_idle_hint(&app);
+    subscribe_to_sleep(&app);
+
+    // Measured from the process start so an activation pays for exec and
+    // linking too, main() alone leaves those out
+    gint64 in_main = g_get_monotonic_time() - started;
+    gint64 ready = process_age_us();
+    if (ready < in_main)
+        ready = in_main;
+    gint32 kb = resident_kb();
+    trace_append(&app, TRACE_RECORD_STARTUP, 0, ready, sensors_held, kb);
+    g_message("Ready to arm %.1f ms after exec, %.1f ms of it in main(), sensors %s, %d KiB resident",
+              ready / 1e3, in_main / 1e3, sensors_held ? "held" : "not held", kb);
 
     app.main_loop = g_main_loop_new(NULL, FALSE);
+    schedule_exit_check(&app);
     g_main_loop_run(app.main_loop);
 
     cleanup_and_exit(&app);
@@ -0,0 +1,275 @@
+// SPDX-License-Identifier: MIT
+// Copyright (C) 2026 Bardia Moshiri <bardia@furilabs.com>
+
+// Decodes a gesture-sensors trace, either a --record file or an event log
+// dumped on SIGUSR1 / io.furios.Gesture.DumpLog, into one line per record.
+// With --json it prints latency distributions instead.
+
+#include <errno.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "trace.h"
+
+struct latency {
+    size_t count;
+    size_t failed;
+    int32_t *us;
+};
+
+static int
+compare_us(const void *a, const void *b)
+{
+    int32_t x = *(const int32_t *)a;
+    int32_t y = *(const int32_t *)b;
+
+    return (x > y) - (x < y);
+}
+
+// Nearest rank, so p99 of a short run is its worst sample
+static int32_t
+percentile(const struct latency *latency, unsigned int p)
+{
+    size_t rank = (latency->count * p + 99) / 100;
+
+    return latency->us[rank > 0 ? rank - 1 : 0];
+}
+
+static void
+print_latency(const char *name, struct latency *latency, int *first)
+{
+    if (latency->count == 0)
+        return;
+
+    qsort(latency->us, latency->count, sizeof(*latency->us), compare_us);
+
+    printf("%s\n    \"%s\": { \"calls\": %zu, \"failed\": %zu, \"min_us\": %" PRId32
+           ", \"p50_us\": %" PRId32 ", \"p99_us\": %" PRId32 ", \"max_us\": %" PRId32 " }",
+           *first ? "" : ",", name, latency->count, latency->failed,
+           latency->us[0], percentile(latency, 50), percentile(latency, 99),
+           latency->us[latency->count - 1]);
+    *first = 0;
+}
+
+// Wake paths are grouped by boost and by whether the wake path was locked
+// in memory at the time, so cold and resident wakes can be told apart
+static const char *const wake_path_names[4] = {
+    "unboosted", "boosted", "unboosted-resident", "boosted-resident",
+};
+
+// Arm gaps are grouped by what marked the screen off and by whether the
+// sessions were requested ahead of it
+static const char *const arm_gap_names[TRACE_ARM_TRIGGERS * 2] = {
+    "idle-hint", "output-off", "idle-hint-prepared", "output-off-prepared",
+};
+
+// Proximity gate checks, split by whether a new sample arrived during the check
+static const char *const proximity_names[2] = { "stale", "fresh" };
+
+static struct latency *
+record_latency(struct latency *methods, struct latency *wake_paths, struct latency *arm_gaps,
+               struct latency *proximity, const struct trace_record *record, int32_t *us, int *resident)
+{
+    if (record->type == TRACE_RECORD_RESIDENT) {
+        *resident = record->value[0] > 0;
+        return NULL;
+    }
+
+    if (record->type == TRACE_RECORD_SENSORFW) {
+        int32_t method = record->value[0];
+        struct latency *latency = &methods[method > 0 && method < TRACE_SENSORFW_METHODS ? method : 0];
+        *us = record->value[1];
+        if (!record->value[2])
+            latency->failed++;
+        return latency;
+    }
+
+    if (record->type == TRACE_RECORD_WAKE_PATH) {
+        *us = record->value[0];
+        return &wake_paths[(record->value[1] ? 1 : 0) + (*resident ? 2 : 0)];
+    }
+
+    if (record->type == TRACE_RECORD_PROXIMITY) {
+        *us = record->value[1];
+        return &proximity[record->value[2] ? 1 : 0];
+    }
+
+    if (record->type == TRACE_RECORD_ARM_GAP) {
+        int32_t trigger = record->value[1];
+        *us = record->value[0];
+        return &arm_gaps[(trigger > 0 && trigger < TRACE_ARM_TRIGGERS ? trigger : 0) +
+                         (record->value[2] ? TRACE_ARM_TRIGGERS : 0)];
+    }
+
+    return NULL;
+}
+
+// The last startup record covers the sysfs-only or gesture-enabled setup
+// the daemon started in, the wake module record what the first arm added
+static void
+print_footprint(const struct trace_reader *reader)
+{
+    const struct trace_record *startup = NULL;
+    const struct trace_record *module = NULL;
+
+    for (size_t i = 0; i < reader->count; i++) {
+        if (reader->records[i].type == TRACE_RECORD_STARTUP)
+            startup = &reader->records[i];
+        else if (reader->records[i].type == TRACE_RECORD_WAKE_MODULE)
+            module = &reader->records[i];
+    }
+
+    if (startup)
+        printf("  \"startup\": { \"ready_us\": %" PRId32 ", \"sensors_held\": %s, \"rss_kb\": %" PRId32 " },\n",
+               startup->value[0], startup->value[1] ? "true" : "false", startup->value[2]);
+    if (module)
+        printf("  \"wake_module\": { \"load_us\": %" PRId32 ", \"loaded\": %s, \"rss_kb\": %" PRId32 " },\n",
+               module->value[0], module->value[1] ? "true" : "false", module->value[2]);
+}
+
+// Per method sensorfw round trips, the wake path split by boost and
+// residency, the screen off to armed gap and proximity gate checks, meant to
+// be diffed between builds
+static int
+print_json(const struct trace_reader *reader)
+{
+    struct latency methods[TRACE_SENSORFW_METHODS] = {0};
+    struct latency wake_paths[4] = {0};
+    struct latency arm_gaps[TRACE_ARM_TRIGGERS * 2] = {0};
+    struct latency proximity[2] = {0};
+    struct latency *latency;
+    int resident = 0;
+    int32_t us;
+    size_t total = 0;
+    int first;
+
+    // Count first so every group gets an exact slice of one allocation
+    for (size_t i = 0; i < reader->count; i++) {
+        latency = record_latency(methods, wake_paths, arm_gaps, proximity, &reader->records[i], &us,
+                                 &resident);
+        if (latency) {
+            latency->count++;
+            total++;
+        }
+    }
+
+    int32_t *pool = malloc(sizeof(int32_t) * (total + 1));
+    if (!pool) {
+        fprintf(stderr, "Out of memory\n");
+        return 1;
+    }
+
+    int32_t *next = pool;
+    for (int32_t method = 0; method < TRACE_SENSORFW_METHODS; method++) {
+        methods[method].us = next;
+        next += methods[method].count;
+        methods[method].count = 0;
+        methods[method].failed = 0;
+    }
+    for (int group = 0; group < 4; group++) {
+        wake_paths[group].us = next;
+        next += wake_paths[group].count;
+        wake_paths[group].count = 0;
+    }
+    for (int group = 0; group < TRACE_ARM_TRIGGERS * 2; group++) {
+        arm_gaps[group].us = next;
+        next += arm_gaps[group].count;
+        arm_gaps[group].count = 0;
+    }
+    for (int group = 0; group < 2; group++) {
+        proximity[group].us = next;
+        next += proximity[group].count;
+        proximity[group].count = 0;
+    }
+
+    resident = 0;
+    for (size_t i = 0; i < reader->count; i++) {
+        latency = record_latency(methods, wake_paths, arm_gaps, proximity, &reader->records[i], &us,
+                                 &resident);
+        if (latency)
+            latency->us[latency->count++] = us;
+    }
+
+    printf("{\n  \"records\": %zu,\n", reader->count);
+    print_footprint(reader);
+    printf("  \"sensorfw\": {");
+    first = 1;
+    for (int32_t method = 0; method < TRACE_SENSORFW_METHODS; method++)
+        print_latency(trace_sensorfw_method_name(method), &methods[method], &first);
+    printf("%s},\n  \"wake_path\": {", first ? "" : "\n  ");
+    first = 1;
+    for (int group = 0; group < 4; group++)
+        print_latency(wake_path_names[group], &wake_paths[group], &first);
+    printf("%s},\n  \"arm_gap\": {", first ? "" : "\n  ");
+    first = 1;
+    for (int group = 0; group < TRACE_ARM_TRIGGERS * 2; group++)
+        print_latency(arm_gap_names[group], &arm_gaps[group], &first);
+    printf("%s},\n  \"proximity\": {", first ? "" : "\n  ");
+    first = 1;
+    for (int group = 0; group < 2; group++)
+        print_latency(proximity_names[group], &proximity[group], &first);
+    printf("%s}\n}\n", first ? "" : "\n  ");
+
+    free(pool);
+
+    return 0;
+}
+
+int
+main(int argc, char *argv[])
+{
+    struct trace_reader reader;
+    const char *path = argv[argc - 1];
+    int json = (argc == 3 && strcmp(argv[1], "--json") == 0);
+
+    if (argc != 2 && !json) {
+        fprintf(stderr, "Usage: %s [--json] TRACE\n", argv[0]);
+        return 1;
+    }
+
+    if (trace_reader_open(&reader, path) < 0) {
+        fprintf(stderr, "Failed to open %s: %s\n", path, strerror(errno));
+        return 1;
+    }
+
+    if (json) {
+        int ret = print_json(&reader);
+        trace_reader_close(&reader);
+        return ret;
+    }
+
+    uint64_t start = reader.count > 0 ? reader.records[0].time : 0;
+
+    for (size_t i = 0; i < reader.count; i++) {
+        const struct trace_record *record = &reader.records[i];
+
+        if (record->type == TRACE_RECORD_SENSORFW) {
+            printf("%12.6f %-12s %20s %11" PRId32 " %11" PRId32 "\n",
+                   (record->time - start) / 1e6,
+                   trace_record_name(record->type),
+                   trace_sensorfw_method_name(record->value[0]),
+                   record->value[1], record->value[2]);
+            continue;
+        }
+
+        if (record->type == TRACE_RECORD_ARM_GAP) {
+            printf("%12.6f %-12s %20s %11" PRId32 " %11" PRId32 "\n",
+                   (record->time - start) / 1e6,
+                   trace_record_name(record->type),
+                   trace_arm_trigger_name(record->value[1]),
+                   record->value[0], record->value[2]);
+            continue;
+        }
+
+        printf("%12.6f %-12s %20" PRIu64 " %11" PRId32 " %11" PRId32 " %11" PRId32 "\n",
+               (record->time - start) / 1e6,
+               trace_record_name(record->type),
+               record->timestamp,
+               record->value[0], record->value[1], record->value[2]);
+    }
+
+    trace_reader_close(&reader);
+
+    return 0;
+}
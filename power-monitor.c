@@ -0,0 +1,203 @@
+// SPDX-License-Identifier: MIT
+// Copyright (C) 2026 Bardia Moshiri <bardia@furilabs.com>
+
+#include "power-monitor.h"
+
+static void
+notify_changed(PowerMonitor *monitor)
+{
+    g_debug("Power: %s, %.0f%%%s",
+            monitor->on_battery ? "on battery" : "on AC",
+            monitor->percentage,
+            monitor->available ? "" : ", UPower not running");
+
+    if (monitor->changed)
+        monitor->changed(monitor->user_data);
+}
+
+// OnBattery lives on the manager and Percentage on the display device, both
+// arrive as a{sv} from GetAll and PropertiesChanged
+static gboolean
+apply_properties(PowerMonitor *monitor, GVariant *properties)
+{
+    gboolean changed = FALSE;
+    gboolean on_battery;
+    gdouble percentage;
+
+    if (g_variant_lookup(properties, "OnBattery", "b", &on_battery) &&
+        on_battery != monitor->on_battery) {
+        monitor->on_battery = on_battery;
+        changed = TRUE;
+    }
+
+    if (g_variant_lookup(properties, "Percentage", "d", &percentage) &&
+        percentage != monitor->percentage) {
+        monitor->percentage = percentage;
+        changed = TRUE;
+    }
+
+    return changed;
+}
+
+static void
+on_properties_changed(GDBusConnection *connection,
+                      const gchar *sender_name,
+                      const gchar *object_path,
+                      const gchar *interface_name,
+                      const gchar *signal_name,
+                      GVariant *parameters,
+                      gpointer user_data)
+{
+    PowerMonitor *monitor = user_data;
+    const gchar *property_interface;
+    GVariant *changed_properties;
+    GVariant *invalidated_properties;
+
+    g_variant_get(parameters, "(&s@a{sv}@as)",
+                  &property_interface,
+                  &changed_properties,
+                  &invalidated_properties);
+
+    if (monitor->available && apply_properties(monitor, changed_properties))
+        notify_changed(monitor);
+
+    g_variant_unref(changed_properties);
+    g_variant_unref(invalidated_properties);
+}
+
+static void
+on_get_all_ready(GObject *source,
+                 GAsyncResult *res,
+                 gpointer user_data)
+{
+    GError *error = NULL;
+    GVariant *result = g_dbus_connection_call_finish(G_DBUS_CONNECTION(source), res, &error);
+    GVariant *properties;
+
+    // Cancelled means the monitor is being cleared, leave it alone
+    if (!result) {
+        if (!g_error_matches(error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+            g_debug("Failed to read UPower properties: %s", error->message);
+        g_error_free(error);
+        return;
+    }
+
+    PowerMonitor *monitor = user_data;
+
+    g_variant_get(result, "(@a{sv})", &properties);
+    monitor->available = TRUE;
+    apply_properties(monitor, properties);
+    notify_changed(monitor);
+
+    g_variant_unref(properties);
+    g_variant_unref(result);
+}
+
+static void
+get_all(PowerMonitor *monitor, const gchar *path, const gchar *interface)
+{
+    g_dbus_connection_call(monitor->connection,
+                           POWER_MONITOR_NAME,
+                           path,
+                           "org.freedesktop.DBus.Properties",
+                           "GetAll",
+                           g_variant_new("(s)", interface),
+                           G_VARIANT_TYPE("(a{sv})"),
+                           G_DBUS_CALL_FLAGS_NO_AUTO_START,
+                           -1,
+                           monitor->cancellable,
+                           on_get_all_ready,
+                           monitor);
+}
+
+// Fires at startup when UPower is already running and again after it
+// restarts, the current state is read once and signals carry it from there
+static void
+on_upower_appeared(GDBusConnection *connection,
+                   const gchar *name,
+                   const gchar *name_owner,
+                   gpointer user_data)
+{
+    PowerMonitor *monitor = user_data;
+
+    get_all(monitor, POWER_MONITOR_PATH, "org.freedesktop.UPower");
+    get_all(monitor, POWER_MONITOR_DISPLAY_DEVICE_PATH, "org.freedesktop.UPower.Device");
+}
+
+static void
+on_upower_vanished(GDBusConnection *connection,
+                   const gchar *name,
+                   gpointer user_data)
+{
+    PowerMonitor *monitor = user_data;
+
+    if (!monitor->available)
+        return;
+
+    monitor->available = FALSE;
+    monitor->on_battery = FALSE;
+    monitor->percentage = 0;
+    notify_changed(monitor);
+}
+
+static guint
+subscribe(PowerMonitor *monitor, const gchar *path, const gchar *interface)
+{
+    return g_dbus_connection_signal_subscribe(monitor->connection,
+                                              POWER_MONITOR_NAME,
+                                              "org.freedesktop.DBus.Properties",
+                                              "PropertiesChanged",
+                                              path,
+                                              interface,
+                                              G_DBUS_SIGNAL_FLAGS_NONE,
+                                              on_properties_changed,
+                                              monitor,
+                                              NULL);
+}
+
+// Signal driven only, nothing is polled. The connection is passed in so a
+// stand-in UPower on a private bus can drive the policy.
+void
+power_monitor_init(PowerMonitor *monitor, GDBusConnection *connection,
+                   PowerMonitorChangedFunc changed, gpointer user_data)
+{
+    monitor->connection = g_object_ref(connection);
+    monitor->changed = changed;
+    monitor->user_data = user_data;
+    monitor->cancellable = g_cancellable_new();
+
+    monitor->manager_subscription_id = subscribe(monitor, POWER_MONITOR_PATH, "org.freedesktop.UPower");
+    monitor->device_subscription_id = subscribe(monitor, POWER_MONITOR_DISPLAY_DEVICE_PATH,
+                                                "org.freedesktop.UPower.Device");
+    monitor->watch_id = g_bus_watch_name_on_connection(connection,
+                                                       POWER_MONITOR_NAME,
+                                                       G_BUS_NAME_WATCHER_FLAGS_NONE,
+                                                       on_upower_appeared,
+                                                       on_upower_vanished,
+                                                       monitor,
+                                                       NULL);
+}
+
+void
+power_monitor_clear(PowerMonitor *monitor)
+{
+    if (monitor->cancellable) {
+        g_cancellable_cancel(monitor->cancellable);
+        g_object_unref(monitor->cancellable);
+    }
+    if (monitor->watch_id > 0)
+        g_bus_unwatch_name(monitor->watch_id);
+    if (monitor->manager_subscription_id > 0)
+        g_dbus_connection_signal_unsubscribe(monitor->connection, monitor->manager_subscription_id);
+    if (monitor->device_subscription_id > 0)
+        g_dbus_connection_signal_unsubscribe(monitor->connection, monitor->device_subscription_id);
+    if (monitor->connection)
+        g_object_unref(monitor->connection);
+
+    monitor->cancellable = NULL;
+    monitor->watch_id = 0;
+    monitor->manager_subscription_id = 0;
+    monitor->device_subscription_id = 0;
+    monitor->connection = NULL;
+    monitor->available = FALSE;
+}
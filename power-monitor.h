@@ -0,0 +1,34 @@
+// SPDX-License-Identifier: MIT
+// Copyright (C) 2026 Bardia Moshiri <bardia@furilabs.com>
+
+#ifndef POWER_MONITOR_H
+#define POWER_MONITOR_H
+
+#include <glib.h>
+#include <gio/gio.h>
+
+#define POWER_MONITOR_NAME "org.freedesktop.UPower"
+#define POWER_MONITOR_PATH "/org/freedesktop/UPower"
+#define POWER_MONITOR_DISPLAY_DEVICE_PATH "/org/freedesktop/UPower/devices/DisplayDevice"
+
+// Called whenever the battery state changes or UPower comes and goes
+typedef void (*PowerMonitorChangedFunc)(gpointer user_data);
+
+typedef struct {
+    GDBusConnection *connection;
+    guint watch_id;
+    guint manager_subscription_id;
+    guint device_subscription_id;
+    GCancellable *cancellable;
+    gboolean available; // FALSE until UPower has answered, and after it leaves
+    gboolean on_battery;
+    gdouble percentage;
+    PowerMonitorChangedFunc changed;
+    gpointer user_data;
+} PowerMonitor;
+
+void power_monitor_init(PowerMonitor *monitor, GDBusConnection *connection,
+                        PowerMonitorChangedFunc changed, gpointer user_data);
+void power_monitor_clear(PowerMonitor *monitor);
+
+#endif // POWER_MONITOR_H
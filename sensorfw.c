@@ -0,0 +1,593 @@
+// SPDX-License-Identifier: MIT
+// Copyright (c) 2024 Jesus Higueras <jesus@furilabs.com>
+// Copyright (C) 2024 Bardia Moshiri <bardia@furilabs.com>
+
+#include <unistd.h>
+#include "sensorfw.h"
+#include "trace.h"
+
+#ifdef G_LOG_DOMAIN
+#undef G_LOG_DOMAIN
+#endif
+#define G_LOG_DOMAIN "GestureSensors"
+
+void
+sensorfw_client_init(SensorfwClient *client, GDBusConnection *connection,
+                     SensorfwRecordFunc record, gpointer user_data)
+{
+    client->connection = connection;
+    client->loaded_plugins = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+    client->record = record;
+    client->user_data = user_data;
+}
+
+void
+sensorfw_client_clear(SensorfwClient *client)
+{
+    g_clear_pointer(&client->loaded_plugins, g_hash_table_destroy);
+}
+
+void
+sensorfw_forget_plugins(SensorfwClient *client)
+{
+    if (client->loaded_plugins)
+        g_hash_table_remove_all(client->loaded_plugins);
+}
+
+// Every sensorfw round trip goes through here and is reported to the record
+// callback, the daemon logs it so gesture-trace --json can summarize where
+// the wake path spends its time per method
+GVariant *
+sensorfw_call(SensorfwClient *client,
+              const gchar *object_path,
+              const gchar *interface_name,
+              const gchar *method_name,
+              GVariant *parameters,
+              const GVariantType *reply_type,
+              GError **error)
+{
+    gint64 started = g_get_monotonic_time();
+    gint32 method = trace_sensorfw_method(method_name);
+    GDBusCallFlags flags = G_DBUS_CALL_FLAGS_NONE;
+    GVariant *result;
+
+    // Only loading a plugin and opening a session may start sensorfw, every
+    // other call refers to a session that died with the previous instance
+    if (method != TRACE_SENSORFW_LOAD_PLUGIN && method != TRACE_SENSORFW_REQUEST_SENSOR)
+        flags |= G_DBUS_CALL_FLAGS_NO_AUTO_START;
+
+    result = g_dbus_connection_call_sync(client->connection,
+                                         SENSORFW_NAME,
+                                         object_path,
+                                         interface_name,
+                                         method_name,
+                                         parameters,
+                                         reply_type,
+                                         flags,
+                                         -1,
+                                         NULL,
+                                         error);
+
+    if (client->record)
+        client->record(method, g_get_monotonic_time() - started, result != NULL, client->user_data);
+
+    return result;
+}
+
+// A plugin stays loaded for the lifetime of sensorfw, so each one is loaded
+// once instead of on every arm. The cache is dropped when sensorfw leaves
+// the bus.
+gboolean
+probe_sensor_plugin(SensorfwClient *client, const gchar *name)
+{
+    GVariant *result;
+    GError *error = NULL;
+    gboolean loaded = FALSE;
+
+    if (g_hash_table_contains(client->loaded_plugins, name))
+        return TRUE;
+
+    result = sensorfw_call(client,
+                           "/SensorManager",
+                           "local.SensorManager",
+                           "loadPlugin",
+                           g_variant_new("(s)", name),
+                           G_VARIANT_TYPE("(b)"),
+                           &error);
+
+    if (error) {
+        g_debug("Failed to probe %s: %s", name, error->message);
+        g_error_free(error);
+        return FALSE;
+    }
+
+    g_variant_get(result, "(b)", &loaded);
+    g_variant_unref(result);
+
+    if (loaded)
+        g_hash_table_add(client->loaded_plugins, g_strdup(name));
+
+    return loaded;
+}
+
+gint32
+request_wake_sensor(SensorfwClient *client)
+{
+    GVariant *result;
+    GError *error = NULL;
+    gint32 session_id = -1;
+
+    if (!probe_sensor_plugin(client, "wakegesturesensor")) {
+        g_warning("Failed to load plugin");
+        return -1;
+    }
+
+    result = sensorfw_call(client,
+                           "/SensorManager",
+                           "local.SensorManager",
+                           "requestSensor",
+                           g_variant_new("(sx)", "wakegesturesensor", (gint64)getpid()),
+                           G_VARIANT_TYPE("(i)"),
+                           &error);
+
+    if (error) {
+        g_warning("Failed to request sensor: %s", error->message);
+        g_error_free(error);
+        return -1;
+    }
+
+    g_variant_get(result, "(i)", &session_id);
+    g_variant_unref(result);
+
+    result = sensorfw_call(client,
+                           "/SensorManager/wakegesturesensor",
+                           "local.WakeGestureSensor",
+                           "start",
+                           g_variant_new("(i)", session_id),
+                           NULL,
+                           &error);
+
+    if (error) {
+        g_warning("Failed to start sensor: %s", error->message);
+        g_clear_error(&error);
+    }
+
+    if (result)
+        g_variant_unref(result);
+
+    return session_id;
+}
+
+void
+release_wake_sensor(SensorfwClient *client, gint32 session_id)
+{
+    GVariant *result;
+    GError *error = NULL;
+
+    result = sensorfw_call(client,
+                           "/SensorManager/wakegesturesensor",
+                           "local.WakeGestureSensor",
+                           "stop",
+                           g_variant_new("(i)", session_id),
+                           NULL,
+                           &error);
+
+    if (error) {
+        g_warning("Failed to stop sensor: %s", error->message);
+        g_clear_error(&error);
+    }
+
+    if (result)
+        g_variant_unref(result);
+
+    result = sensorfw_call(client,
+                           "/SensorManager",
+                           "local.SensorManager",
+                           "releaseSensor",
+                           g_variant_new("(six)", "wakegesturesensor", session_id, (gint64)getpid()),
+                           NULL,
+                           &error);
+
+    if (error) {
+        g_warning("Failed to release sensor: %s", error->message);
+        g_clear_error(&error);
+    }
+
+    if (result)
+        g_variant_unref(result);
+}
+
+guint32
+get_wake_sensor_reading(SensorfwClient *client, guint64 *timestamp)
+{
+    GVariant *result;
+    GError *error = NULL;
+    guint32 wake_gesture = 0;
+    result = sensorfw_call(client,
+                           "/SensorManager/wakegesturesensor",
+                           "org.freedesktop.DBus.Properties",
+                           "Get",
+                           g_variant_new("(ss)", "local.WakeGestureSensor", "wakegesture"),
+                           G_VARIANT_TYPE("(v)"),
+                           &error);
+
+    if (error) {
+        g_warning("Failed to get sensor reading: %s", error->message);
+        g_error_free(error);
+        return 0;
+    }
+
+    GVariant *value;
+    g_variant_get(result, "(v)", &value);
+    g_variant_get(value, "(tu)", timestamp, &wake_gesture);
+
+    g_variant_unref(value);
+    g_variant_unref(result);
+
+    return wake_gesture;
+}
+
+gint32
+request_tilt_sensor(SensorfwClient *client)
+{
+    GVariant *result;
+    GError *error = NULL;
+    gint32 session_id = -1;
+
+    if (!probe_sensor_plugin(client, "tiltdetectorsensor")) {
+        g_warning("Failed to load tilt sensor plugin");
+        return -1;
+    }
+
+    result = sensorfw_call(client,
+                           "/SensorManager",
+                           "local.SensorManager",
+                           "requestSensor",
+                           g_variant_new("(sx)", "tiltdetectorsensor", (gint64)getpid()),
+                           G_VARIANT_TYPE("(i)"),
+                           &error);
+
+    if (error) {
+        g_warning("Failed to request tilt sensor: %s", error->message);
+        g_error_free(error);
+        return -1;
+    }
+
+    g_variant_get(result, "(i)", &session_id);
+    g_variant_unref(result);
+
+    result = sensorfw_call(client,
+                           "/SensorManager/tiltdetectorsensor",
+                           "local.TiltDetectorSensor",
+                           "start",
+                           g_variant_new("(i)", session_id),
+                           NULL,
+                           &error);
+
+    if (error) {
+        g_warning("Failed to start tilt sensor: %s", error->message);
+        g_clear_error(&error);
+    }
+
+    if (result)
+        g_variant_unref(result);
+
+    return session_id;
+}
+
+void
+release_tilt_sensor(SensorfwClient *client, gint32 session_id)
+{
+    GVariant *result;
+    GError *error = NULL;
+
+    result = sensorfw_call(client,
+                           "/SensorManager/tiltdetectorsensor",
+                           "local.TiltDetectorSensor",
+                           "stop",
+                           g_variant_new("(i)", session_id),
+                           NULL,
+                           &error);
+
+    if (error) {
+        g_warning("Failed to stop tilt sensor: %s", error->message);
+        g_clear_error(&error);
+    }
+
+    if (result)
+        g_variant_unref(result);
+
+    result = sensorfw_call(client,
+                           "/SensorManager",
+                           "local.SensorManager",
+                           "releaseSensor",
+                           g_variant_new("(six)", "tiltdetectorsensor", session_id, (gint64)getpid()),
+                           NULL,
+                           &error);
+
+    if (error) {
+        g_warning("Failed to release tilt sensor: %s", error->message);
+        g_clear_error(&error);
+    }
+
+    if (result)
+        g_variant_unref(result);
+}
+
+guint32
+get_tilt_sensor_reading(SensorfwClient *client, guint64 *timestamp)
+{
+    GVariant *result;
+    GError *error = NULL;
+    guint32 tilt_detected = 0;
+    result = sensorfw_call(client,
+                           "/SensorManager/tiltdetectorsensor",
+                           "org.freedesktop.DBus.Properties",
+                           "Get",
+                           g_variant_new("(ss)", "local.TiltDetectorSensor", "tiltdetector"),
+                           G_VARIANT_TYPE("(v)"),
+                           &error);
+    if (error) {
+        g_warning("Failed to get tilt sensor reading: %s", error->message);
+        g_error_free(error);
+        return 0;
+    }
+
+    GVariant *value;
+    g_variant_get(result, "(v)", &value);
+    g_variant_get(value, "(tu)", timestamp, &tilt_detected);
+
+    g_variant_unref(value);
+    g_variant_unref(result);
+
+    return tilt_detected;
+}
+
+gint32
+request_accel_sensor(SensorfwClient *client)
+{
+    GVariant *result;
+    GError *error = NULL;
+    gint32 session_id = -1;
+
+    if (!probe_sensor_plugin(client, "accelerometersensor")) {
+        g_warning("Failed to load accelerometer plugin");
+        return -1;
+    }
+
+    result = sensorfw_call(client,
+                           "/SensorManager",
+                           "local.SensorManager",
+                           "requestSensor",
+                           g_variant_new("(sx)", "accelerometersensor", (gint64)getpid()),
+                           G_VARIANT_TYPE("(i)"),
+                           &error);
+
+    if (error) {
+        g_warning("Failed to request accelerometer: %s", error->message);
+        g_error_free(error);
+        return -1;
+    }
+
+    g_variant_get(result, "(i)", &session_id);
+    g_variant_unref(result);
+
+    result = sensorfw_call(client,
+                           "/SensorManager/accelerometersensor",
+                           "local.AccelerometerSensor",
+                           "setInterval",
+                           g_variant_new("(ii)", session_id, SENSORFW_ACCEL_INTERVAL_MS),
+                           NULL,
+                           &error);
+
+    if (error) {
+        g_warning("Failed to set accelerometer interval: %s", error->message);
+        g_clear_error(&error);
+    }
+
+    if (result)
+        g_variant_unref(result);
+
+    result = sensorfw_call(client,
+                           "/SensorManager/accelerometersensor",
+                           "local.AccelerometerSensor",
+                           "start",
+                           g_variant_new("(i)", session_id),
+                           NULL,
+                           &error);
+
+    if (error) {
+        g_warning("Failed to start accelerometer: %s", error->message);
+        g_clear_error(&error);
+    }
+
+    if (result)
+        g_variant_unref(result);
+
+    return session_id;
+}
+
+void
+release_accel_sensor(SensorfwClient *client, gint32 session_id)
+{
+    GVariant *result;
+    GError *error = NULL;
+
+    result = sensorfw_call(client,
+                           "/SensorManager/accelerometersensor",
+                           "local.AccelerometerSensor",
+                           "stop",
+                           g_variant_new("(i)", session_id),
+                           NULL,
+                           &error);
+
+    if (error) {
+        g_warning("Failed to stop accelerometer: %s", error->message);
+        g_clear_error(&error);
+    }
+
+    if (result)
+        g_variant_unref(result);
+
+    result = sensorfw_call(client,
+                           "/SensorManager",
+                           "local.SensorManager",
+                           "releaseSensor",
+                           g_variant_new("(six)", "accelerometersensor", session_id, (gint64)getpid()),
+                           NULL,
+                           &error);
+
+    if (error) {
+        g_warning("Failed to release accelerometer: %s", error->message);
+        g_clear_error(&error);
+    }
+
+    if (result)
+        g_variant_unref(result);
+}
+
+gboolean
+get_accel_sensor_reading(SensorfwClient *client, struct accel_sample *sample)
+{
+    GVariant *result;
+    GError *error = NULL;
+    guint64 timestamp;
+    gint32 x, y, z;
+
+    result = sensorfw_call(client,
+                           "/SensorManager/accelerometersensor",
+                           "org.freedesktop.DBus.Properties",
+                           "Get",
+                           g_variant_new("(ss)", "local.AccelerometerSensor", "xyz"),
+                           G_VARIANT_TYPE("(v)"),
+                           &error);
+    if (error) {
+        g_warning("Failed to get accelerometer reading: %s", error->message);
+        g_error_free(error);
+        return FALSE;
+    }
+
+    GVariant *value;
+    g_variant_get(result, "(v)", &value);
+    g_variant_get(value, "(tiii)", &timestamp, &x, &y, &z);
+
+    sample->timestamp = timestamp;
+    sample->x = x;
+    sample->y = y;
+    sample->z = z;
+
+    g_variant_unref(value);
+    g_variant_unref(result);
+
+    return TRUE;
+}
+
+gint32
+request_proximity_sensor(SensorfwClient *client)
+{
+    GVariant *result;
+    GError *error = NULL;
+    gint32 session_id = -1;
+
+    if (!probe_sensor_plugin(client, "proximitysensor")) {
+        g_warning("Failed to load proximity plugin");
+        return -1;
+    }
+
+    // The session is only opened here, the sensor itself stays off until
+    // a gesture has to be checked against it
+    result = sensorfw_call(client,
+                           "/SensorManager",
+                           "local.SensorManager",
+                           "requestSensor",
+                           g_variant_new("(sx)", "proximitysensor", (gint64)getpid()),
+                           G_VARIANT_TYPE("(i)"),
+                           &error);
+
+    if (error) {
+        g_warning("Failed to request proximity sensor: %s", error->message);
+        g_error_free(error);
+        return -1;
+    }
+
+    g_variant_get(result, "(i)", &session_id);
+    g_variant_unref(result);
+
+    return session_id;
+}
+
+void
+release_proximity_sensor(SensorfwClient *client, gint32 session_id)
+{
+    GVariant *result;
+    GError *error = NULL;
+
+    result = sensorfw_call(client,
+                           "/SensorManager",
+                           "local.SensorManager",
+                           "releaseSensor",
+                           g_variant_new("(six)", "proximitysensor", session_id, (gint64)getpid()),
+                           NULL,
+                           &error);
+
+    if (error) {
+        g_warning("Failed to release proximity sensor: %s", error->message);
+        g_clear_error(&error);
+    }
+
+    if (result)
+        g_variant_unref(result);
+}
+
+void
+set_proximity_sensor_running(SensorfwClient *client, gint32 session_id, gboolean running)
+{
+    GVariant *result;
+    GError *error = NULL;
+
+    result = sensorfw_call(client,
+                           "/SensorManager/proximitysensor",
+                           "local.ProximitySensor",
+                           running ? "start" : "stop",
+                           g_variant_new("(i)", session_id),
+                           NULL,
+                           &error);
+
+    if (error) {
+        g_warning("Failed to %s proximity sensor: %s", running ? "start" : "stop", error->message);
+        g_clear_error(&error);
+    }
+
+    if (result)
+        g_variant_unref(result);
+}
+
+gboolean
+get_proximity_reading(SensorfwClient *client, guint64 *timestamp, guint32 *proximity)
+{
+    GVariant *result;
+    GError *error = NULL;
+    GVariant *value;
+
+    result = sensorfw_call(client,
+                           "/SensorManager/proximitysensor",
+                           "org.freedesktop.DBus.Properties",
+                           "Get",
+                           g_variant_new("(ss)", "local.ProximitySensor", "proximity"),
+                           G_VARIANT_TYPE("(v)"),
+                           &error);
+
+    if (error) {
+        g_warning("Failed to get proximity reading: %s", error->message);
+        g_error_free(error);
+        return FALSE;
+    }
+
+    g_variant_get(result, "(v)", &value);
+    g_variant_get(value, "(tu)", timestamp, proximity);
+
+    g_variant_unref(value);
+    g_variant_unref(result);
+
+    return TRUE;
+}
@@ -0,0 +1,58 @@
+// SPDX-License-Identifier: MIT
+// Copyright (c) 2024 Jesus Higueras <jesus@furilabs.com>
+// Copyright (C) 2024 Bardia Moshiri <bardia@furilabs.com>
+
+#ifndef SENSORFW_H
+#define SENSORFW_H
+
+#include <glib.h>
+#include <gio/gio.h>
+#include "accel-gesture.h"
+
+#define SENSORFW_NAME "com.nokia.SensorService"
+#define SENSORFW_ACCEL_INTERVAL_MS 100
+
+// Called after every round trip with its trace_sensorfw_method id
+typedef void (*SensorfwRecordFunc)(gint32 method, gint64 elapsed_us, gboolean ok,
+                                   gpointer user_data);
+
+typedef struct {
+    GDBusConnection *connection;
+    GHashTable *loaded_plugins;
+    SensorfwRecordFunc record;
+    gpointer user_data;
+} SensorfwClient;
+
+void sensorfw_client_init(SensorfwClient *client, GDBusConnection *connection,
+                          SensorfwRecordFunc record, gpointer user_data);
+void sensorfw_client_clear(SensorfwClient *client);
+// Plugins are gone with the sensorfw instance that loaded them
+void sensorfw_forget_plugins(SensorfwClient *client);
+
+GVariant *sensorfw_call(SensorfwClient *client,
+                        const gchar *object_path,
+                        const gchar *interface_name,
+                        const gchar *method_name,
+                        GVariant *parameters,
+                        const GVariantType *reply_type,
+                        GError **error);
+gboolean probe_sensor_plugin(SensorfwClient *client, const gchar *name);
+
+gint32 request_wake_sensor(SensorfwClient *client);
+void release_wake_sensor(SensorfwClient *client, gint32 session_id);
+guint32 get_wake_sensor_reading(SensorfwClient *client, guint64 *timestamp);
+
+gint32 request_tilt_sensor(SensorfwClient *client);
+void release_tilt_sensor(SensorfwClient *client, gint32 session_id);
+guint32 get_tilt_sensor_reading(SensorfwClient *client, guint64 *timestamp);
+
+gint32 request_accel_sensor(SensorfwClient *client);
+void release_accel_sensor(SensorfwClient *client, gint32 session_id);
+gboolean get_accel_sensor_reading(SensorfwClient *client, struct accel_sample *sample);
+
+gint32 request_proximity_sensor(SensorfwClient *client);
+void release_proximity_sensor(SensorfwClient *client, gint32 session_id);
+void set_proximity_sensor_running(SensorfwClient *client, gint32 session_id, gboolean running);
+gboolean get_proximity_reading(SensorfwClient *client, guint64 *timestamp, guint32 *proximity);
+
+#endif // SENSORFW_H
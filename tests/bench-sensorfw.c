@@ -0,0 +1,419 @@
+// SPDX-License-Identifier: MIT
+// Copyright (C) 2026 Bardia Moshiri <bardia@furilabs.com>
+
+// Times the sensorfw round trips of one arm and release of every sensor the
+// daemon uses against a stand-in com.nokia.SensorService on a private bus.
+// The stand-in replies straight away from its own thread, so the figures
+// are the bus and client cost the daemon pays, not sensorfw's own work.
+// The same calls are issued four ways:
+//
+//   sync-serial     request_*, get_* and release_* from sensorfw.c, one
+//                   sensor after the other, as the daemon arms today
+//   sync-parallel   the same functions, one thread per sensor
+//   async-serial    g_dbus_connection_call(), each reply awaited before
+//                   the next call goes out
+//   async-parallel  each step (request, setInterval, start, Get, stop,
+//                   release) in flight for every sensor at once
+//
+// Prints min/p50/p99/max per method and per cycle as JSON. Skipped (exit
+// 77) without a dbus-daemon to run the private bus.
+//
+// usage: bench-sensorfw [cycles]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include "sensorfw.h"
+#include "trace.h"
+#include "sensorfw-stand-in.h"
+
+#define DEFAULT_CYCLES 1000
+
+struct latency {
+    GArray *us;
+    guint failed;
+};
+
+typedef struct {
+    const char *name;
+    struct latency methods[TRACE_SENSORFW_METHODS];
+    struct latency cycle;
+} Mode;
+
+typedef struct {
+    GDBusConnection *connection;
+    SensorfwClient client;
+    GMutex lock; // sync-parallel records from several threads
+    Mode *mode;
+    guint failed;
+    guint pending;
+    gint32 sessions[SENSORS];
+} Bench;
+
+static void
+latency_add(struct latency *latency, gint64 us, gboolean ok)
+{
+    gint32 sample = (gint32)MIN(us, G_MAXINT32);
+
+    if (!latency->us)
+        latency->us = g_array_new(FALSE, FALSE, sizeof(gint32));
+    g_array_append_val(latency->us, sample);
+    if (!ok)
+        latency->failed++;
+}
+
+static void
+record(Bench *bench, gint32 method, gint64 elapsed_us, gboolean ok)
+{
+    g_mutex_lock(&bench->lock);
+    if (bench->mode)
+        latency_add(&bench->mode->methods[method > 0 && method < TRACE_SENSORFW_METHODS ? method : 0],
+                    elapsed_us, ok);
+    if (!ok)
+        bench->failed++;
+    g_mutex_unlock(&bench->lock);
+}
+
+static void
+record_sensorfw_call(gint32 method, gint64 elapsed_us, gboolean ok, gpointer user_data)
+{
+    record(user_data, method, elapsed_us, ok);
+}
+
+// One arm and release of a sensor the way the daemon does it, with the
+// reading the first poll takes in between
+static void
+sync_sensor(SensorfwClient *client, int sensor)
+{
+    struct accel_sample sample;
+    guint64 timestamp;
+    guint32 proximity;
+    gint32 session;
+
+    switch (sensor) {
+    case SENSOR_WAKE:
+        session = request_wake_sensor(client);
+        get_wake_sensor_reading(client, &timestamp);
+        release_wake_sensor(client, session);
+        break;
+    case SENSOR_TILT:
+        session = request_tilt_sensor(client);
+        get_tilt_sensor_reading(client, &timestamp);
+        release_tilt_sensor(client, session);
+        break;
+    case SENSOR_ACCEL:
+        session = request_accel_sensor(client);
+        get_accel_sensor_reading(client, &sample);
+        release_accel_sensor(client, session);
+        break;
+    case SENSOR_PROXIMITY:
+        session = request_proximity_sensor(client);
+        set_proximity_sensor_running(client, session, TRUE);
+        get_proximity_reading(client, &timestamp, &proximity);
+        set_proximity_sensor_running(client, session, FALSE);
+        release_proximity_sensor(client, session);
+        break;
+    }
+}
+
+static void
+sync_serial(Bench *bench)
+{
+    for (int sensor = 0; sensor < SENSORS; sensor++)
+        sync_sensor(&bench->client, sensor);
+}
+
+typedef struct {
+    Bench *bench;
+    int sensor;
+} SyncJob;
+
+static gpointer
+sync_job_run(gpointer user_data)
+{
+    SyncJob *job = user_data;
+
+    sync_sensor(&job->bench->client, job->sensor);
+    return NULL;
+}
+
+// The plugin cache is only read once the warm-up cycle has filled it, so
+// the threads can share the client
+static void
+sync_parallel(Bench *bench)
+{
+    SyncJob jobs[SENSORS];
+    GThread *threads[SENSORS];
+
+    for (int sensor = 0; sensor < SENSORS; sensor++) {
+        jobs[sensor] = (SyncJob) { bench, sensor };
+        threads[sensor] = g_thread_new("sensor", sync_job_run, &jobs[sensor]);
+    }
+    for (int sensor = 0; sensor < SENSORS; sensor++)
+        g_thread_join(threads[sensor]);
+}
+
+enum {
+    STEP_REQUEST,
+    STEP_SET_INTERVAL,
+    STEP_START,
+    STEP_GET,
+    STEP_STOP,
+    STEP_RELEASE,
+    STEPS,
+};
+
+typedef struct {
+    Bench *bench;
+    int sensor;
+    gint32 method;
+    gint64 started;
+} AsyncCall;
+
+static void
+on_async_reply(GObject *source, GAsyncResult *res, gpointer user_data)
+{
+    AsyncCall *call = user_data;
+    Bench *bench = call->bench;
+    GError *error = NULL;
+    GVariant *result = g_dbus_connection_call_finish(G_DBUS_CONNECTION(source), res, &error);
+
+    record(bench, call->method, g_get_monotonic_time() - call->started, result != NULL);
+
+    if (error) {
+        g_printerr("%s: %s\n", trace_sensorfw_method_name(call->method), error->message);
+        g_error_free(error);
+    } else {
+        if (call->method == TRACE_SENSORFW_REQUEST_SENSOR)
+            g_variant_get(result, "(i)", &bench->sessions[call->sensor]);
+        g_variant_unref(result);
+    }
+
+    bench->pending--;
+    g_free(call);
+}
+
+// Issues the same call sync_sensor() makes at this step, FALSE when the
+// sensor has no such step
+static gboolean
+async_step(Bench *bench, int sensor, int step)
+{
+    gchar *path = g_strdup_printf("/SensorManager/%s", stand_in_sensors[sensor].plugin);
+    const char *object_path = path;
+    const char *interface = stand_in_sensors[sensor].interface;
+    const char *method;
+    GVariant *parameters;
+    gint32 session = bench->sessions[sensor];
+
+    switch (step) {
+    case STEP_REQUEST:
+        object_path = "/SensorManager";
+        interface = "local.SensorManager";
+        method = "requestSensor";
+        parameters = g_variant_new("(sx)", stand_in_sensors[sensor].plugin, (gint64)getpid());
+        break;
+    case STEP_SET_INTERVAL:
+        if (sensor != SENSOR_ACCEL) {
+            g_free(path);
+            return FALSE;
+        }
+        method = "setInterval";
+        parameters = g_variant_new("(ii)", session, SENSORFW_ACCEL_INTERVAL_MS);
+        break;
+    case STEP_START:
+    case STEP_STOP:
+        method = step == STEP_START ? "start" : "stop";
+        parameters = g_variant_new("(i)", session);
+        break;
+    case STEP_GET:
+        interface = "org.freedesktop.DBus.Properties";
+        method = "Get";
+        parameters = g_variant_new("(ss)", stand_in_sensors[sensor].interface, stand_in_sensors[sensor].property);
+        break;
+    default:
+        object_path = "/SensorManager";
+        interface = "local.SensorManager";
+        method = "releaseSensor";
+        parameters = g_variant_new("(six)", stand_in_sensors[sensor].plugin, session, (gint64)getpid());
+        break;
+    }
+
+    AsyncCall *call = g_new(AsyncCall, 1);
+    *call = (AsyncCall) { bench, sensor, trace_sensorfw_method(method), g_get_monotonic_time() };
+    bench->pending++;
+    g_dbus_connection_call(bench->connection, SENSORFW_NAME, object_path, interface, method,
+                           parameters, NULL, G_DBUS_CALL_FLAGS_NONE, -1, NULL, on_async_reply,
+                           call);
+    g_free(path);
+    return TRUE;
+}
+
+static void
+async_wait(Bench *bench)
+{
+    while (bench->pending > 0)
+        g_main_context_iteration(NULL, TRUE);
+}
+
+static void
+async_serial(Bench *bench)
+{
+    for (int sensor = 0; sensor < SENSORS; sensor++)
+        for (int step = 0; step < STEPS; step++)
+            if (async_step(bench, sensor, step))
+                async_wait(bench);
+}
+
+// Later steps need the session from the request, so only calls of the same
+// step overlap
+static void
+async_parallel(Bench *bench)
+{
+    for (int step = 0; step < STEPS; step++) {
+        for (int sensor = 0; sensor < SENSORS; sensor++)
+            async_step(bench, sensor, step);
+        async_wait(bench);
+    }
+}
+
+static int
+compare_us(gconstpointer a, gconstpointer b)
+{
+    gint32 x = *(const gint32 *)a;
+    gint32 y = *(const gint32 *)b;
+
+    return (x > y) - (x < y);
+}
+
+// Nearest rank, as in gesture-trace --json
+static gint32
+percentile(const struct latency *latency, guint p)
+{
+    guint rank = (latency->us->len * p + 99) / 100;
+
+    return g_array_index(latency->us, gint32, rank > 0 ? rank - 1 : 0);
+}
+
+static void
+print_latency(const char *indent, const char *name, struct latency *latency, int *first)
+{
+    if (!latency->us || latency->us->len == 0)
+        return;
+
+    g_array_sort(latency->us, compare_us);
+
+    printf("%s\n%s\"%s\": { \"calls\": %u, \"failed\": %u, \"min_us\": %d"
+           ", \"p50_us\": %d, \"p99_us\": %d, \"max_us\": %d }",
+           *first ? "" : ",", indent, name, latency->us->len, latency->failed,
+           g_array_index(latency->us, gint32, 0), percentile(latency, 50),
+           percentile(latency, 99), g_array_index(latency->us, gint32, latency->us->len - 1));
+    *first = 0;
+}
+
+static void
+print_mode(Mode *mode, gboolean last)
+{
+    int first = 1;
+
+    printf("    \"%s\": {", mode->name);
+    print_latency("      ", "cycle", &mode->cycle, &first);
+    printf(",\n      \"methods\": {");
+    first = 1;
+    for (gint32 method = 0; method < TRACE_SENSORFW_METHODS; method++)
+        print_latency("        ", trace_sensorfw_method_name(method), &mode->methods[method],
+                      &first);
+    printf("%s}\n    }%s\n", first ? "" : "\n      ", last ? "" : ",");
+}
+
+static void
+mode_clear(Mode *mode)
+{
+    for (gint32 method = 0; method < TRACE_SENSORFW_METHODS; method++)
+        if (mode->methods[method].us)
+            g_array_free(mode->methods[method].us, TRUE);
+    if (mode->cycle.us)
+        g_array_free(mode->cycle.us, TRUE);
+}
+
+int
+main(int argc, char **argv)
+{
+    guint cycles = argc > 1 ? strtoul(argv[1], NULL, 10) : DEFAULT_CYCLES;
+    Mode modes[] = {
+        { .name = "sync-serial" },
+        { .name = "sync-parallel" },
+        { .name = "async-serial" },
+        { .name = "async-parallel" },
+    };
+    void (*const runs[])(Bench *) = { sync_serial, sync_parallel, async_serial, async_parallel };
+    Bench bench = { 0 };
+    StandIn stand_in = { 0 };
+    GTestDBus *bus;
+    GError *error = NULL;
+    gchar *daemon = g_find_program_in_path("dbus-daemon");
+    int ret = 0;
+
+    if (!daemon) {
+        g_printerr("No dbus-daemon for the private bus\n");
+        return 77;
+    }
+    g_free(daemon);
+
+    bus = g_test_dbus_new(G_TEST_DBUS_NONE);
+    g_test_dbus_up(bus);
+
+    if (!stand_in_start(&stand_in, g_test_dbus_get_bus_address(bus))) {
+        ret = 1;
+        goto out;
+    }
+
+    bench.connection = g_dbus_connection_new_for_address_sync(
+        g_test_dbus_get_bus_address(bus),
+        G_DBUS_CONNECTION_FLAGS_AUTHENTICATION_CLIENT |
+        G_DBUS_CONNECTION_FLAGS_MESSAGE_BUS_CONNECTION,
+        NULL, NULL, &error);
+    if (!bench.connection) {
+        g_printerr("Failed to connect: %s\n", error->message);
+        g_error_free(error);
+        ret = 1;
+        goto out;
+    }
+    g_mutex_init(&bench.lock);
+    sensorfw_client_init(&bench.client, bench.connection, record_sensorfw_call, &bench);
+
+    // Loads the plugins, which the daemon does once per sensorfw instance
+    sync_serial(&bench);
+
+    for (guint i = 0; i < G_N_ELEMENTS(modes); i++) {
+        bench.mode = &modes[i];
+        for (guint cycle = 0; cycle < cycles; cycle++) {
+            gint64 started = g_get_monotonic_time();
+
+            runs[i](&bench);
+            latency_add(&modes[i].cycle, g_get_monotonic_time() - started, TRUE);
+        }
+    }
+    bench.mode = NULL;
+
+    printf("{\n  \"cycles\": %u,\n  \"modes\": {\n", cycles);
+    for (guint i = 0; i < G_N_ELEMENTS(modes); i++)
+        print_mode(&modes[i], i == G_N_ELEMENTS(modes) - 1);
+    printf("  }\n}\n");
+
+    if (bench.failed > 0) {
+        g_printerr("%u calls failed\n", bench.failed);
+        ret = 1;
+    }
+
+    for (guint i = 0; i < G_N_ELEMENTS(modes); i++)
+        mode_clear(&modes[i]);
+    sensorfw_client_clear(&bench.client);
+    g_mutex_clear(&bench.lock);
+
+out:
+    g_clear_object(&bench.connection);
+    stand_in_stop(&stand_in);
+    g_test_dbus_down(bus);
+    g_object_unref(bus);
+    return ret;
+}
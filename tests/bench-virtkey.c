@@ -0,0 +1,148 @@
+// SPDX-License-Identifier: MIT
+// Copyright (C) 2026 Bardia Moshiri <bardia@furilabs.com>
+
+// Times the parts of run_text() that run in the daemon for a 10k
+// character text: resolving characters to key codes through the keymap
+// index, building the command list in the arena, and typing it through
+// the uinput path into /dev/null. The virtual keyboard path is not timed,
+// it is bound by compositor round trips and fixed 2 ms sleeps per key.
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <time.h>
+#include <wchar.h>
+#include "virtkey.h"
+
+#define TEXT_LENGTH 10000
+#define ROUNDS 50
+
+static wchar_t text[TEXT_LENGTH];
+static unsigned int codes[TEXT_LENGTH];
+
+static double
+now_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static void
+report(const char *name, double elapsed_ns, size_t items)
+{
+    printf("%-24s %10.1f ns/char %12.3f ms total\n", name, elapsed_ns / items, elapsed_ns / 1e6);
+}
+
+// Mostly ASCII with some Latin-1 and Greek so the keymap grows past its
+// first few index rebuilds
+static void
+fill_text(void)
+{
+    for (size_t i = 0; i < TEXT_LENGTH; i++) {
+        switch (i % 7) {
+        case 5:
+            text[i] = 0xc0 + i % 64;
+            break;
+        case 6:
+            text[i] = 0x391 + i % 25;
+            break;
+        default:
+            text[i] = 0x21 + i % 94;
+            break;
+        }
+    }
+}
+
+static int
+bench_resolve(struct wtype *wtype)
+{
+    double started = now_ns();
+
+    for (size_t i = 0; i < TEXT_LENGTH; i++) {
+        codes[i] = get_key_code_by_wchar(wtype, text[i]);
+        if (codes[i] == WTYPE_KEY_CODE_NONE) {
+            fprintf(stderr, "Failed to resolve character %zu: %s\n", i, strerror(wtype->error));
+            return -1;
+        }
+    }
+    report("resolve, cold keymap", now_ns() - started, TEXT_LENGTH);
+
+    started = now_ns();
+    for (int round = 0; round < ROUNDS; round++)
+        for (size_t i = 0; i < TEXT_LENGTH; i++)
+            codes[i] = get_key_code_by_wchar(wtype, text[i]);
+    report("resolve, warm keymap", (now_ns() - started) / ROUNDS, TEXT_LENGTH);
+
+    printf("%-24s %10zu entries\n", "keymap", wtype->keymap_len);
+    return 0;
+}
+
+static int
+bench_commands(struct wtype *wtype)
+{
+    if (wtype_arena_init(&wtype->arena, sizeof(struct wtype_command) + TEXT_LENGTH * sizeof(unsigned int) + 64) < 0)
+        return -1;
+
+    double started = now_ns();
+    for (int round = 0; round < ROUNDS; round++) {
+        wtype_arena_reset(&wtype->arena);
+        wtype->commands = wtype_alloc_commands(wtype, 1);
+        wtype->commands[0].key_codes = wtype_alloc_key_codes(wtype, TEXT_LENGTH);
+        if (!wtype->commands[0].key_codes)
+            return -1;
+        memcpy(wtype->commands[0].key_codes, codes, sizeof(codes));
+    }
+    report("build command list", (now_ns() - started) / ROUNDS, TEXT_LENGTH);
+
+    wtype_arena_free(&wtype->arena);
+    wtype->commands = NULL;
+    return 0;
+}
+
+// Only keys the uinput device registers can be typed, the text is made of
+// those
+static int
+bench_uinput(void)
+{
+    static const wchar_t typable[] = { L' ', L'\n', L'\t', L'\e' };
+    struct wtype wtype = { .uinput_fd = open("/dev/null", O_WRONLY | O_CLOEXEC) };
+    struct wtype_command cmd = {
+        .type = WTYPE_COMMAND_TEXT,
+        .key_codes = codes,
+        .key_codes_len = TEXT_LENGTH,
+    };
+
+    if (wtype.uinput_fd < 0)
+        return -1;
+
+    for (size_t i = 0; i < TEXT_LENGTH; i++)
+        codes[i] = get_key_code_by_wchar(&wtype, typable[i % ARRAY_SIZE(typable)]);
+
+    double started = now_ns();
+    run_text(&wtype, &cmd);
+    report("run_text, uinput", now_ns() - started, TEXT_LENGTH);
+
+    close(wtype.uinput_fd);
+    if (wtype.error) {
+        fprintf(stderr, "uinput run_text failed: %s\n", strerror(wtype.error));
+        return -1;
+    }
+    return 0;
+}
+
+int
+main(void)
+{
+    struct wtype wtype = { .uinput_fd = -1 };
+    int ret = 0;
+
+    fill_text();
+
+    if (bench_resolve(&wtype) < 0 || bench_commands(&wtype) < 0 || bench_uinput() < 0)
+        ret = 1;
+
+    wtype_free_keymap(&wtype);
+    return ret;
+}
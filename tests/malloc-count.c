@@ -0,0 +1,108 @@
+// SPDX-License-Identifier: MIT
+// Copyright (C) 2026 Bardia Moshiri <bardia@furilabs.com>
+
+// LD_PRELOAD shim counting live heap blocks. The soak looks
+// malloc_count_live() up at run time and only checks RSS without it.
+
+#include <errno.h>
+#include <stddef.h>
+
+extern void *__libc_malloc(size_t size);
+extern void *__libc_calloc(size_t nmemb, size_t size);
+extern void *__libc_realloc(void *ptr, size_t size);
+extern void *__libc_memalign(size_t alignment, size_t size);
+extern void __libc_free(void *ptr);
+
+static long live;
+static unsigned long total;
+
+long
+malloc_count_live(void)
+{
+    return __atomic_load_n(&live, __ATOMIC_RELAXED);
+}
+
+unsigned long
+malloc_count_total(void)
+{
+    return __atomic_load_n(&total, __ATOMIC_RELAXED);
+}
+
+static void
+count(void *ptr, long delta)
+{
+    if (!ptr)
+        return;
+    __atomic_add_fetch(&live, delta, __ATOMIC_RELAXED);
+    if (delta > 0)
+        __atomic_add_fetch(&total, 1, __ATOMIC_RELAXED);
+}
+
+void *
+malloc(size_t size)
+{
+    void *ptr = __libc_malloc(size);
+
+    count(ptr, 1);
+    return ptr;
+}
+
+void *
+calloc(size_t nmemb, size_t size)
+{
+    void *ptr = __libc_calloc(nmemb, size);
+
+    count(ptr, 1);
+    return ptr;
+}
+
+// A moved block is one free and one allocation, the live count only
+// changes when realloc() allocates or frees outright
+void *
+realloc(void *ptr, size_t size)
+{
+    void *moved = __libc_realloc(ptr, size);
+
+    if (!ptr)
+        count(moved, 1);
+    else if (size == 0)
+        count(ptr, -1);
+    else if (moved && moved != ptr)
+        __atomic_add_fetch(&total, 1, __ATOMIC_RELAXED);
+    return moved;
+}
+
+void *
+memalign(size_t alignment, size_t size)
+{
+    void *ptr = __libc_memalign(alignment, size);
+
+    count(ptr, 1);
+    return ptr;
+}
+
+void *
+aligned_alloc(size_t alignment, size_t size)
+{
+    return memalign(alignment, size);
+}
+
+int
+posix_memalign(void **out, size_t alignment, size_t size)
+{
+    if (alignment < sizeof(void *) || (alignment & (alignment - 1)))
+        return EINVAL;
+
+    void *ptr = memalign(alignment, size);
+    if (!ptr)
+        return ENOMEM;
+    *out = ptr;
+    return 0;
+}
+
+void
+free(void *ptr)
+{
+    count(ptr, -1);
+    __libc_free(ptr);
+}
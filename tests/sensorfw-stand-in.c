@@ -0,0 +1,244 @@
+// SPDX-License-Identifier: MIT
+// Copyright (C) 2026 Bardia Moshiri <bardia@furilabs.com>
+
+#include <string.h>
+#include "sensorfw.h"
+#include "sensorfw-stand-in.h"
+
+const StandInSensor stand_in_sensors[SENSORS] = {
+    [SENSOR_WAKE] = { "wakegesturesensor", "local.WakeGestureSensor", "wakegesture", "(tu)" },
+    [SENSOR_TILT] = { "tiltdetectorsensor", "local.TiltDetectorSensor", "tiltdetector", "(tu)" },
+    [SENSOR_ACCEL] = { "accelerometersensor", "local.AccelerometerSensor", "xyz", "(tiii)" },
+    [SENSOR_PROXIMITY] = { "proximitysensor", "local.ProximitySensor", "proximity", "(tu)" },
+};
+
+static const char manager_xml[] =
+    "<node>"
+    "  <interface name='local.SensorManager'>"
+    "    <method name='loadPlugin'>"
+    "      <arg direction='in' type='s'/><arg direction='out' type='b'/>"
+    "    </method>"
+    "    <method name='requestSensor'>"
+    "      <arg direction='in' type='s'/><arg direction='in' type='x'/>"
+    "      <arg direction='out' type='i'/>"
+    "    </method>"
+    "    <method name='releaseSensor'>"
+    "      <arg direction='in' type='s'/><arg direction='in' type='i'/>"
+    "      <arg direction='in' type='x'/><arg direction='out' type='b'/>"
+    "    </method>"
+    "  </interface>"
+    "</node>";
+
+// Every sensor takes the same session calls, only the reading differs
+static const char sensor_xml[] =
+    "<node>"
+    "  <interface name='%s'>"
+    "    <method name='start'><arg direction='in' type='i'/></method>"
+    "    <method name='stop'><arg direction='in' type='i'/></method>"
+    "    <method name='setInterval'>"
+    "      <arg direction='in' type='i'/><arg direction='in' type='i'/>"
+    "    </method>"
+    "    <property name='%s' type='%s' access='read'/>"
+    "  </interface>"
+    "</node>";
+
+static void
+stand_in_method_call(GDBusConnection *connection,
+                     const gchar *sender,
+                     const gchar *object_path,
+                     const gchar *interface_name,
+                     const gchar *method_name,
+                     GVariant *parameters,
+                     GDBusMethodInvocation *invocation,
+                     gpointer user_data)
+{
+    StandIn *stand_in = user_data;
+
+    if (g_strcmp0(method_name, "requestSensor") == 0)
+        g_dbus_method_invocation_return_value(invocation,
+                                              g_variant_new("(i)", ++stand_in->next_session));
+    else if (g_strcmp0(method_name, "loadPlugin") == 0 ||
+             g_strcmp0(method_name, "releaseSensor") == 0)
+        g_dbus_method_invocation_return_value(invocation, g_variant_new("(b)", TRUE));
+    else
+        g_dbus_method_invocation_return_value(invocation, NULL);
+}
+
+static GVariant *
+stand_in_get_property(GDBusConnection *connection,
+                      const gchar *sender,
+                      const gchar *object_path,
+                      const gchar *interface_name,
+                      const gchar *property_name,
+                      GError **error,
+                      gpointer user_data)
+{
+    StandIn *stand_in = user_data;
+    guint64 timestamp = g_get_monotonic_time();
+
+    // Only the accelerometer reading has a different shape
+    if (g_strcmp0(property_name, "xyz") == 0)
+        return g_variant_new("(tiii)", timestamp, 0, 0, 981);
+
+    return g_variant_new("(tu)", timestamp, stand_in->reading);
+}
+
+static const GDBusInterfaceVTable manager_vtable = {
+    .method_call = stand_in_method_call,
+};
+
+static const GDBusInterfaceVTable sensor_vtable = {
+    .method_call = stand_in_method_call,
+    .get_property = stand_in_get_property,
+};
+
+static gboolean
+stand_in_register(GDBusConnection *connection, const char *path, const char *xml,
+                  const GDBusInterfaceVTable *vtable, gpointer user_data)
+{
+    GError *error = NULL;
+    GDBusNodeInfo *info = g_dbus_node_info_new_for_xml(xml, &error);
+    guint id = 0;
+
+    if (info) {
+        id = g_dbus_connection_register_object(connection, path, info->interfaces[0], vtable,
+                                               user_data, NULL, &error);
+        g_dbus_node_info_unref(info);
+    }
+
+    if (!id) {
+        g_printerr("Failed to register %s: %s\n", path, error->message);
+        g_error_free(error);
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+// Runs on the GDBus worker thread for every message, property reads never
+// reach a method handler so calls are counted here
+static GDBusMessage *
+count_call(GDBusConnection *connection, GDBusMessage *message, gboolean incoming,
+           gpointer user_data)
+{
+    StandIn *stand_in = user_data;
+    gint32 method;
+
+    if (!incoming || g_dbus_message_get_message_type(message) != G_DBUS_MESSAGE_TYPE_METHOD_CALL)
+        return message;
+
+    method = trace_sensorfw_method(g_dbus_message_get_member(message));
+    g_mutex_lock(&stand_in->lock);
+    stand_in->calls[method]++;
+    if (!(g_dbus_message_get_flags(message) & G_DBUS_MESSAGE_FLAGS_NO_AUTO_START))
+        stand_in->auto_start[method]++;
+    g_mutex_unlock(&stand_in->lock);
+
+    return message;
+}
+
+static gpointer
+stand_in_run(gpointer user_data)
+{
+    StandIn *stand_in = user_data;
+
+    g_main_context_push_thread_default(stand_in->context);
+    g_main_loop_run(stand_in->loop);
+    g_main_context_pop_thread_default(stand_in->context);
+
+    return NULL;
+}
+
+// Objects are registered with the stand-in's context as the thread default,
+// so their calls are dispatched on its thread and never wait on the client
+gboolean
+stand_in_start(StandIn *stand_in, const gchar *address)
+{
+    GError *error = NULL;
+    GVariant *result;
+    gboolean ok;
+
+    stand_in->connection = g_dbus_connection_new_for_address_sync(
+        address, G_DBUS_CONNECTION_FLAGS_AUTHENTICATION_CLIENT |
+                 G_DBUS_CONNECTION_FLAGS_MESSAGE_BUS_CONNECTION,
+        NULL, NULL, &error);
+    if (!stand_in->connection) {
+        g_printerr("Failed to connect the stand-in: %s\n", error->message);
+        g_error_free(error);
+        return FALSE;
+    }
+
+    g_mutex_init(&stand_in->lock);
+    g_dbus_connection_add_filter(stand_in->connection, count_call, stand_in, NULL);
+
+    stand_in->context = g_main_context_new();
+    stand_in->loop = g_main_loop_new(stand_in->context, FALSE);
+
+    g_main_context_push_thread_default(stand_in->context);
+    ok = stand_in_register(stand_in->connection, "/SensorManager", manager_xml, &manager_vtable,
+                           stand_in);
+    for (int sensor = 0; ok && sensor < SENSORS; sensor++) {
+        gchar *path = g_strdup_printf("/SensorManager/%s", stand_in_sensors[sensor].plugin);
+        gchar *xml = g_strdup_printf(sensor_xml, stand_in_sensors[sensor].interface,
+                                     stand_in_sensors[sensor].property, stand_in_sensors[sensor].type);
+
+        ok = stand_in_register(stand_in->connection, path, xml, &sensor_vtable, stand_in);
+        g_free(xml);
+        g_free(path);
+    }
+    g_main_context_pop_thread_default(stand_in->context);
+
+    if (!ok)
+        return FALSE;
+
+    result = g_dbus_connection_call_sync(stand_in->connection,
+                                         "org.freedesktop.DBus",
+                                         "/org/freedesktop/DBus",
+                                         "org.freedesktop.DBus",
+                                         "RequestName",
+                                         g_variant_new("(su)", SENSORFW_NAME, 0),
+                                         G_VARIANT_TYPE("(u)"),
+                                         G_DBUS_CALL_FLAGS_NONE,
+                                         -1,
+                                         NULL,
+                                         &error);
+    if (!result) {
+        g_printerr("Failed to own %s: %s\n", SENSORFW_NAME, error->message);
+        g_error_free(error);
+        return FALSE;
+    }
+    g_variant_unref(result);
+
+    stand_in->thread = g_thread_new("stand-in", stand_in_run, stand_in);
+    return TRUE;
+}
+
+void
+stand_in_stop(StandIn *stand_in)
+{
+    if (stand_in->thread) {
+        g_main_loop_quit(stand_in->loop);
+        g_thread_join(stand_in->thread);
+    }
+    g_clear_pointer(&stand_in->loop, g_main_loop_unref);
+    g_clear_pointer(&stand_in->context, g_main_context_unref);
+    g_clear_object(&stand_in->connection);
+}
+
+guint
+stand_in_take_calls(StandIn *stand_in, guint calls[TRACE_SENSORFW_METHODS],
+                    guint auto_start[TRACE_SENSORFW_METHODS])
+{
+    guint total = 0;
+
+    g_mutex_lock(&stand_in->lock);
+    for (gint32 method = 0; method < TRACE_SENSORFW_METHODS; method++)
+        total += stand_in->calls[method];
+    memcpy(calls, stand_in->calls, sizeof(stand_in->calls));
+    memcpy(auto_start, stand_in->auto_start, sizeof(stand_in->auto_start));
+    memset(stand_in->calls, 0, sizeof(stand_in->calls));
+    memset(stand_in->auto_start, 0, sizeof(stand_in->auto_start));
+    g_mutex_unlock(&stand_in->lock);
+
+    return total;
+}
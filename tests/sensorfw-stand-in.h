@@ -0,0 +1,50 @@
+// SPDX-License-Identifier: MIT
+// Copyright (C) 2026 Bardia Moshiri <bardia@furilabs.com>
+
+// A stand-in com.nokia.SensorService for the sensorfw bench and tests. It
+// owns the name on the given bus, answers every call the daemon makes from
+// its own thread straight away, and counts the calls it receives.
+
+#ifndef SENSORFW_STAND_IN_H
+#define SENSORFW_STAND_IN_H
+
+#include <glib.h>
+#include <gio/gio.h>
+#include "trace.h"
+
+enum {
+    SENSOR_WAKE,
+    SENSOR_TILT,
+    SENSOR_ACCEL,
+    SENSOR_PROXIMITY,
+    SENSORS,
+};
+
+typedef struct {
+    const char *plugin;
+    const char *interface;
+    const char *property;
+    const char *type;
+} StandInSensor;
+
+extern const StandInSensor stand_in_sensors[SENSORS];
+
+typedef struct {
+    GDBusConnection *connection;
+    GMainContext *context;
+    GMainLoop *loop;
+    GThread *thread;
+    gint next_session;
+    guint32 reading; // what every (tu) reading reports, set before stand_in_start()
+    GMutex lock;
+    guint calls[TRACE_SENSORFW_METHODS];
+    guint auto_start[TRACE_SENSORFW_METHODS]; // calls without NO_AUTO_START
+} StandIn;
+
+gboolean stand_in_start(StandIn *stand_in, const gchar *address);
+void stand_in_stop(StandIn *stand_in);
+// Copies the per-method counts out, resets them and returns their total
+guint stand_in_take_calls(StandIn *stand_in, guint calls[TRACE_SENSORFW_METHODS],
+                          guint auto_start[TRACE_SENSORFW_METHODS]);
+
+#endif // SENSORFW_STAND_IN_H
@@ -0,0 +1,276 @@
+// SPDX-License-Identifier: MIT
+// Copyright (C) 2026 Bardia Moshiri <bardia@furilabs.com>
+
+// Drives idle -> arm -> gesture -> wake cycles through the daemon's own wake
+// path: the wake machine, sensorfw.c against the sensorfw stand-in, the
+// event ring and its dumps, and wake-action.c alternating between its
+// virtual keyboard backend, against a stand-in compositor, and its uinput
+// backend typing into /dev/null. Resident memory, live heap blocks (with
+// malloc-count.so preloaded) and open descriptors are sampled after a
+// warm-up and at the end, any growth fails the run. Skipped (exit 77)
+// without a dbus-daemon for the private bus or XDG_RUNTIME_DIR for the
+// compositor socket.
+//
+// usage: soak-wake [cycles]
+
+#include <dirent.h>
+#include <dlfcn.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include "sensorfw.h"
+#include "sensorfw-stand-in.h"
+#include "trace.h"
+#include "wake-action.h"
+#include "wake-machine.h"
+#include "wayland-stand-in.h"
+
+#define DEFAULT_CYCLES 20000
+#define DEBOUNCE_US 500000
+#define DUMP_EVERY 1000
+// wake_action_init() runs again whenever the wake module is reloaded
+#define RELOAD_EVERY 1000
+// Pages the allocator may still settle into after the warm-up
+#define RSS_SLACK_KIB 64
+// Messages the GDBus worker thread may not have freed yet at a sample
+#define HEAP_SLACK_BLOCKS 32
+
+struct sample {
+    long rss_kib;
+    long heap_blocks;
+    long fds;
+};
+
+struct soak {
+    GDBusConnection *connection;
+    SensorfwClient sensorfw;
+    gint32 session;
+    WakeAction wake;
+    unsigned long keyboard_wakes;
+};
+
+static long (*heap_blocks)(void);
+
+static long
+resident_kib(void)
+{
+    long size, resident = -1;
+    FILE *statm = fopen("/proc/self/statm", "r");
+
+    if (!statm)
+        return -1;
+    if (fscanf(statm, "%ld %ld", &size, &resident) != 2)
+        resident = -1;
+    fclose(statm);
+    return resident * (sysconf(_SC_PAGESIZE) / 1024);
+}
+
+static long
+open_fds(void)
+{
+    DIR *dir = opendir("/proc/self/fd");
+    long count = 0;
+
+    if (!dir)
+        return -1;
+    while (readdir(dir))
+        count++;
+    closedir(dir);
+    return count;
+}
+
+static void
+take_sample(struct sample *sample)
+{
+    sample->rss_kib = resident_kib();
+    sample->heap_blocks = heap_blocks ? heap_blocks() : -1;
+    sample->fds = open_fds();
+}
+
+// What loading the wake module does. A real uinput device would type into
+// the session, the uinput backend writes to /dev/null instead.
+static int
+wake_init(struct soak *soak)
+{
+    wake_action_init(&soak->wake, soak->connection);
+    uinput_close(&soak->wake.uinput);
+    soak->wake.uinput.uinput_fd = open("/dev/null", O_WRONLY | O_CLOEXEC);
+    return soak->wake.uinput.uinput_fd < 0 ? -1 : 0;
+}
+
+// The daemon's apply_actions() for the wake sensor alone, WAKE goes first
+static int
+apply(struct soak *soak, unsigned int actions)
+{
+    if ((actions & WAKE_MACHINE_WAKE) && !wake_action_run(&soak->wake, FALSE))
+        return -1;
+    if ((actions & WAKE_MACHINE_RELEASE) && soak->session != -1) {
+        release_wake_sensor(&soak->sensorfw, soak->session);
+        soak->session = -1;
+    }
+    if (actions & WAKE_MACHINE_ACQUIRE) {
+        soak->session = request_wake_sensor(&soak->sensorfw);
+        if (soak->session == -1)
+            return -1;
+    }
+    return 0;
+}
+
+static int
+cycle(struct soak *soak, struct wake_machine *wm, uint64_t *now, unsigned long i)
+{
+    struct wake_machine_reading reading = { 0 };
+    gint backend = i % 2 ? WAKE_BACKEND_UINPUT : WAKE_BACKEND_VIRTUAL_KEYBOARD;
+    unsigned int actions;
+
+    wake_machine_idle(wm, 1, *now);
+    trace_log(TRACE_RECORD_IDLE_HINT, *now, 1, 0, 0);
+
+    *now += DEBOUNCE_US;
+    actions = wake_machine_arm_timer(wm, *now);
+    trace_log(TRACE_RECORD_ARM, *now, wm->state, actions, 0);
+    if (wm->state != WAKE_MACHINE_ARMED || apply(soak, actions) < 0)
+        return -1;
+
+    // The stand-in reports every reading latched, on its own clock
+    reading.wake = get_wake_sensor_reading(&soak->sensorfw, &reading.wake_timestamp);
+    trace_log(TRACE_RECORD_WAKE, reading.wake_timestamp, reading.wake, 0, 0);
+
+    wake_action_set_backend(&soak->wake, wake_action_backend_name(backend));
+    actions = wake_machine_reading(wm, &reading);
+    if (!(actions & WAKE_MACHINE_WAKE) || apply(soak, actions) < 0 ||
+        soak->wake.last_backend != backend)
+        return -1;
+    if (backend == WAKE_BACKEND_VIRTUAL_KEYBOARD)
+        soak->keyboard_wakes++;
+
+    wake_machine_screen(wm, 1);
+    trace_log(TRACE_RECORD_IDLE_HINT, *now, 0, 0, 0);
+    return apply(soak, wake_machine_idle(wm, 0, *now));
+}
+
+int
+main(int argc, char **argv)
+{
+    // Stand-in readings are microseconds apart, every one is its own gesture
+    const struct wake_machine_config config = { DEBOUNCE_US, 0 };
+    unsigned long cycles = argc > 1 ? strtoul(argv[1], NULL, 10) : DEFAULT_CYCLES;
+    unsigned long warm_up = cycles / 100 > RELOAD_EVERY ? cycles / 100 : RELOAD_EVERY;
+    char dump[] = "/tmp/soak-wake-XXXXXX";
+    struct soak soak = { .session = -1 };
+    StandIn sensorfw = { .reading = 1 };
+    WaylandStandIn compositor = { 0 };
+    struct wake_machine wm;
+    struct sample before = { 0 }, after;
+    GTestDBus *bus;
+    GError *error = NULL;
+    gchar *daemon;
+    uint64_t now = 1;
+    int dump_fd;
+
+    if (cycles <= warm_up) {
+        fprintf(stderr, "Need more than %lu cycles\n", warm_up);
+        return 1;
+    }
+
+    daemon = g_find_program_in_path("dbus-daemon");
+    if (!daemon) {
+        fprintf(stderr, "No dbus-daemon for the private bus\n");
+        return 77;
+    }
+    g_free(daemon);
+    if (!g_getenv("XDG_RUNTIME_DIR")) {
+        fprintf(stderr, "No XDG_RUNTIME_DIR for the compositor socket\n");
+        return 77;
+    }
+
+    heap_blocks = (long (*)(void)) dlsym(RTLD_DEFAULT, "malloc_count_live");
+    if (!heap_blocks)
+        fprintf(stderr, "malloc-count.so is not preloaded, heap blocks are not tracked\n");
+
+    dump_fd = mkstemp(dump);
+    if (dump_fd < 0) {
+        perror("mkstemp");
+        return 1;
+    }
+    close(dump_fd);
+
+    // The first sample pages in the buffers sampling itself uses
+    take_sample(&before);
+
+    bus = g_test_dbus_new(G_TEST_DBUS_NONE);
+    g_test_dbus_up(bus);
+    if (!stand_in_start(&sensorfw, g_test_dbus_get_bus_address(bus)) ||
+        !wayland_stand_in_start(&compositor)) {
+        fprintf(stderr, "Failed to start the stand-ins\n");
+        return 1;
+    }
+
+    soak.connection = g_dbus_connection_new_for_address_sync(
+        g_test_dbus_get_bus_address(bus),
+        G_DBUS_CONNECTION_FLAGS_AUTHENTICATION_CLIENT |
+        G_DBUS_CONNECTION_FLAGS_MESSAGE_BUS_CONNECTION,
+        NULL, NULL, &error);
+    if (!soak.connection) {
+        fprintf(stderr, "Failed to connect to the private bus: %s\n", error->message);
+        return 1;
+    }
+    sensorfw_client_init(&soak.sensorfw, soak.connection, NULL, NULL);
+
+    wake_machine_init(&wm, &config);
+    wake_machine_settings(&wm, 1, 0, 0, now);
+    if (wake_init(&soak) < 0) {
+        perror("Failed to open /dev/null for uinput");
+        return 1;
+    }
+
+    for (unsigned long i = 1; i <= cycles; i++) {
+        if (cycle(&soak, &wm, &now, i) < 0) {
+            fprintf(stderr, "Cycle %lu did not wake\n", i);
+            return 1;
+        }
+        if (i % DUMP_EVERY == 0 && trace_log_dump(dump) < 0) {
+            perror("trace_log_dump");
+            return 1;
+        }
+        if (i % RELOAD_EVERY == 0) {
+            wake_action_clear(&soak.wake);
+            if (wake_init(&soak) < 0) {
+                perror("Failed to open /dev/null for uinput");
+                return 1;
+            }
+        }
+        if (i == warm_up)
+            take_sample(&before);
+    }
+    take_sample(&after);
+
+    apply(&soak, WAKE_MACHINE_RELEASE);
+    wake_action_clear(&soak.wake);
+    sensorfw_client_clear(&soak.sensorfw);
+    g_object_unref(soak.connection);
+    wayland_stand_in_stop(&compositor);
+    stand_in_stop(&sensorfw);
+    g_test_dbus_down(bus);
+    g_object_unref(bus);
+    unlink(dump);
+
+    printf("%lu cycles, %u acquisitions, %d of %lu keyboard wakes seen by the compositor\n",
+           cycles, wm.acquisitions, g_atomic_int_get(&compositor.keys), soak.keyboard_wakes);
+    printf("%-12s %10s %10s\n", "", "warm", "end");
+    printf("%-12s %10ld %10ld\n", "RSS KiB", before.rss_kib, after.rss_kib);
+    printf("%-12s %10ld %10ld\n", "heap blocks", before.heap_blocks, after.heap_blocks);
+    printf("%-12s %10ld %10ld\n", "fds", before.fds, after.fds);
+
+    if ((unsigned long) g_atomic_int_get(&compositor.keys) != soak.keyboard_wakes) {
+        fprintf(stderr, "The compositor missed virtual keyboard wakes\n");
+        return 1;
+    }
+    if (after.rss_kib > before.rss_kib + RSS_SLACK_KIB ||
+        after.heap_blocks > before.heap_blocks + HEAP_SLACK_BLOCKS || after.fds > before.fds) {
+        fprintf(stderr, "Memory or descriptors grew over the soak\n");
+        return 1;
+    }
+    return 0;
+}
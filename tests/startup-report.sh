@@ -0,0 +1,74 @@
+#!/bin/sh
+# SPDX-License-Identifier: MIT
+# Copyright (C) 2026 Bardia Moshiri <bardia@furilabs.com>
+#
+# Starts the daemon for real in three setups and prints the startup record
+# it writes once ready to arm:
+#
+#   sysfs-only       every gesture feature off, only the sysfs toggles
+#   gesture-enabled  wake and tilt gestures on, sensors requested up front
+#   fully-armed      as gesture-enabled with the wake module loaded too
+#
+# Settings come from a throwaway keyfile backend with the schema in SCHEMADIR,
+# so the user's own are left alone. Needs the system bus the daemon runs
+# against, sensors_held is false without sensorfw on it. The wake module
+# is taken from GESTURE_SENSORS_WAKE_MODULE when set.
+#
+# usage: startup-report.sh DAEMON TOOL SCHEMADIR
+
+daemon=$1
+tool=$2
+schemadir=$3
+config=$(mktemp -d "${TMPDIR:-/tmp}/gesture-startup-XXXXXX")
+trace=$config/startup.trace
+status=0
+
+trap 'rm -rf "$config"' EXIT
+
+if ! glib-compile-schemas --targetdir="$config" "$schemadir"; then
+    echo "  startup: failed to compile the schema in $schemadir"
+    exit 1
+fi
+mkdir -p "$config/glib-2.0/settings"
+
+export GSETTINGS_BACKEND=keyfile
+export GSETTINGS_SCHEMA_DIR="$config"
+export XDG_CONFIG_HOME="$config"
+
+# usage: start NAME GESTURES [DAEMON_ARGS...]
+start() {
+    name=$1
+    gestures=$2
+    shift 2
+
+    printf '[io/furios/gesture]\nwake-sensor-enabled=%s\ntilt-sensor-enabled=%s\ninput-wake-enabled=false\n' \
+        "$gestures" "$gestures" > "$config/glib-2.0/settings/keyfile"
+    rm -f "$trace"
+
+    "$daemon" --record "$trace" "$@" > /dev/null 2>&1 &
+    pid=$!
+
+    startup=
+    tries=0
+    while [ -z "$startup" ] && [ $tries -lt 100 ] && kill -0 $pid 2> /dev/null; do
+        sleep 0.05
+        startup=$("$tool" --json "$trace" 2> /dev/null | grep '"startup"')
+        tries=$((tries + 1))
+    done
+
+    kill $pid 2> /dev/null
+    wait $pid 2> /dev/null
+
+    if [ -z "$startup" ]; then
+        echo "  $name: no startup record within 5 s"
+        status=1
+        return
+    fi
+    echo "$startup" | sed "s/^ *\"startup\": { \(.*\) },*\$/  $name: \1/"
+}
+
+start sysfs-only false
+start gesture-enabled true
+start fully-armed true --load-wake-module
+
+exit $status
@@ -0,0 +1,122 @@
+// SPDX-License-Identifier: MIT
+// Copyright (C) 2026 Bardia Moshiri <bardia@furilabs.com>
+
+// Creates a uinput stand-in for a touch panel that reports KEY_WAKEUP and
+// checks that the evdev source picks it by name, skips it under the name the
+// wake action injects through, and delivers a wake key press on the
+// monotonic clock. Skipped (exit 77) without write access to /dev/uinput.
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <linux/uinput.h>
+#include "evdev-source.h"
+
+#define STAND_IN_NAME "gesture-sensors evdev test"
+#define TIMEOUT_MS 2000
+
+typedef struct {
+    guint16 code;
+    guint64 timestamp;
+} Wake;
+
+static int
+stand_in_open(void)
+{
+    struct uinput_setup setup = {
+        .id = { .bustype = BUS_VIRTUAL, .vendor = 0x1, .product = 0x1 },
+    };
+    int fd = open("/dev/uinput", O_WRONLY | O_NONBLOCK | O_CLOEXEC);
+
+    if (fd < 0)
+        return -1;
+
+    g_strlcpy(setup.name, STAND_IN_NAME, sizeof(setup.name));
+    if (ioctl(fd, UI_SET_EVBIT, EV_KEY) < 0 || ioctl(fd, UI_SET_KEYBIT, KEY_WAKEUP) < 0 ||
+        ioctl(fd, UI_DEV_SETUP, &setup) < 0 || ioctl(fd, UI_DEV_CREATE) < 0) {
+        close(fd);
+        return -1;
+    }
+
+    return fd;
+}
+
+static void
+stand_in_emit(int fd, guint16 type, guint16 code, gint32 value)
+{
+    struct input_event ev = { .type = type, .code = code, .value = value };
+
+    g_assert_cmpint(write(fd, &ev, sizeof(ev)), ==, sizeof(ev));
+}
+
+static void
+on_wake(guint16 code, guint64 timestamp, gpointer user_data)
+{
+    Wake *wake = user_data;
+
+    wake->code = code;
+    wake->timestamp = timestamp;
+}
+
+// udev needs a moment to create the node after UI_DEV_CREATE
+static gboolean
+open_stand_in(EvdevSource *src, Wake *wake)
+{
+    for (int tries = 0; tries < 50; tries++) {
+        if (evdev_source_open(src, STAND_IN_NAME, NULL, on_wake, wake))
+            return TRUE;
+        g_usleep(20000);
+    }
+
+    return FALSE;
+}
+
+int
+main(void)
+{
+    EvdevSource src;
+    Wake wake = { 0 };
+    int fd = stand_in_open();
+
+    if (fd < 0) {
+        g_printerr("No uinput stand-in: %s\n", g_strerror(errno));
+        return 77;
+    }
+
+    evdev_source_init(&src);
+
+    if (!open_stand_in(&src, &wake)) {
+        g_printerr("The stand-in never showed up under /dev/input\n");
+        return 77;
+    }
+    g_assert_nonnull(src.path);
+
+    // The wake action's own device must never be picked
+    EvdevSource skipped;
+    evdev_source_init(&skipped);
+    g_assert_false(evdev_source_open(&skipped, STAND_IN_NAME, STAND_IN_NAME, on_wake, &wake));
+
+    guint64 before = g_get_monotonic_time();
+
+    // Only presses count, the release is ignored
+    stand_in_emit(fd, EV_KEY, KEY_WAKEUP, 1);
+    stand_in_emit(fd, EV_SYN, SYN_REPORT, 0);
+    stand_in_emit(fd, EV_KEY, KEY_WAKEUP, 0);
+    stand_in_emit(fd, EV_SYN, SYN_REPORT, 0);
+
+    guint64 deadline = before + TIMEOUT_MS * 1000;
+    while (!wake.code && g_get_monotonic_time() < deadline)
+        if (!g_main_context_iteration(NULL, FALSE))
+            g_usleep(1000);
+
+    g_assert_cmpuint(wake.code, ==, KEY_WAKEUP);
+    g_assert_cmpuint(wake.timestamp, >=, before);
+    g_assert_cmpuint(wake.timestamp, <=, g_get_monotonic_time());
+
+    evdev_source_close(&src);
+    ioctl(fd, UI_DEV_DESTROY);
+    close(fd);
+    return 0;
+}
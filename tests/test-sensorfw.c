@@ -0,0 +1,96 @@
+// SPDX-License-Identifier: MIT
+// Copyright (C) 2026 Bardia Moshiri <bardia@furilabs.com>
+
+// Runs idle cycles the way the daemon arms by default, the wake gesture and
+// tilt sensors requested and started on IdleHint, polled once and released
+// on wake, through sensorfw.c against the stand-in service. Checks the
+// message budget of each cycle: plugins are only loaded until sensorfw is
+// known to have them, and only loadPlugin and requestSensor may start
+// sensorfw. Skipped (exit 77) without a dbus-daemon to run the private bus.
+
+#include "sensorfw.h"
+#include "sensorfw-stand-in.h"
+
+#define CYCLES 3
+// requestSensor, start, Get, stop and releaseSensor per sensor
+#define MESSAGES_PER_CYCLE 10
+#define PLUGINS 2
+
+static void
+idle_cycle(SensorfwClient *client)
+{
+    guint64 timestamp;
+    gint32 wake = request_wake_sensor(client);
+    gint32 tilt = request_tilt_sensor(client);
+
+    g_assert_cmpint(wake, !=, -1);
+    g_assert_cmpint(tilt, !=, -1);
+
+    get_wake_sensor_reading(client, &timestamp);
+    get_tilt_sensor_reading(client, &timestamp);
+
+    release_wake_sensor(client, wake);
+    release_tilt_sensor(client, tilt);
+}
+
+static void
+check_cycle(StandIn *stand_in, guint plugins)
+{
+    guint calls[TRACE_SENSORFW_METHODS];
+    guint auto_start[TRACE_SENSORFW_METHODS];
+    guint total = stand_in_take_calls(stand_in, calls, auto_start);
+
+    g_assert_cmpuint(total, ==, MESSAGES_PER_CYCLE + plugins);
+    g_assert_cmpuint(calls[TRACE_SENSORFW_LOAD_PLUGIN], ==, plugins);
+    g_assert_cmpuint(calls[TRACE_SENSORFW_OTHER], ==, 0);
+
+    for (gint32 method = 0; method < TRACE_SENSORFW_METHODS; method++)
+        if (method != TRACE_SENSORFW_LOAD_PLUGIN && method != TRACE_SENSORFW_REQUEST_SENSOR)
+            g_assert_cmpuint(auto_start[method], ==, 0);
+}
+
+int
+main(void)
+{
+    StandIn stand_in = { 0 };
+    SensorfwClient client;
+    GDBusConnection *connection;
+    GTestDBus *bus;
+    GError *error = NULL;
+    gchar *daemon = g_find_program_in_path("dbus-daemon");
+
+    if (!daemon) {
+        g_printerr("No dbus-daemon for the private bus\n");
+        return 77;
+    }
+    g_free(daemon);
+
+    bus = g_test_dbus_new(G_TEST_DBUS_NONE);
+    g_test_dbus_up(bus);
+    g_assert_true(stand_in_start(&stand_in, g_test_dbus_get_bus_address(bus)));
+
+    connection = g_dbus_connection_new_for_address_sync(
+        g_test_dbus_get_bus_address(bus),
+        G_DBUS_CONNECTION_FLAGS_AUTHENTICATION_CLIENT |
+        G_DBUS_CONNECTION_FLAGS_MESSAGE_BUS_CONNECTION,
+        NULL, NULL, &error);
+    g_assert_no_error(error);
+    sensorfw_client_init(&client, connection, NULL, NULL);
+
+    for (int cycle = 0; cycle < CYCLES; cycle++) {
+        idle_cycle(&client);
+        check_cycle(&stand_in, cycle == 0 ? PLUGINS : 0);
+    }
+
+    // A restarted sensorfw has to load them again
+    sensorfw_forget_plugins(&client);
+    idle_cycle(&client);
+    check_cycle(&stand_in, PLUGINS);
+
+    sensorfw_client_clear(&client);
+    g_object_unref(connection);
+    stand_in_stop(&stand_in);
+    g_test_dbus_down(bus);
+    g_object_unref(bus);
+    return 0;
+}
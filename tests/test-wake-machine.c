@@ -0,0 +1,360 @@
+// SPDX-License-Identifier: MIT
+// Copyright (C) 2026 Bardia Moshiri <bardia@furilabs.com>
+
+// Drives the wake machine through a table of event sequences with the
+// actions and state expected after each step, then through random event
+// streams checking properties that must hold for any order of events, and
+// last times a full idle -> arm -> wake cycle.
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "wake-machine.h"
+
+#define DEBOUNCE_US 250000
+#define DEDUP_US 1000000
+#define RANDOM_STEPS 1000000
+#define BENCH_CYCLES 1000000
+#define MAX_STEPS 8
+
+enum event {
+    EV_END = 0,
+    EV_SETTINGS, // arg: bit 0 wake, bit 1 tilt, bit 2 listening
+    EV_IDLE,     // arg: idle
+    EV_ARM_TIMER,
+    EV_BLANK,
+    EV_PREPARE,
+    EV_SCREEN,   // arg: on
+    EV_WAKE,     // arg: sensor timestamp of a wake latch
+    EV_TILT,     // arg: sensor timestamp of a tilt latch
+    EV_BLOCKED,  // vetoes the previous step's actions
+    EV_INPUT,    // arg: input event timestamp
+    EV_SLEEP,    // arg: sleeping
+    EV_COUNT,
+};
+
+static const char *const event_names[EV_COUNT] = {
+    "end", "settings", "idle", "arm-timer", "blank", "prepare", "screen",
+    "wake", "tilt", "blocked", "input", "sleep",
+};
+
+struct step {
+    enum event event;
+    uint64_t arg;
+    uint64_t now;
+    unsigned int actions;
+    enum wake_machine_state state;
+};
+
+struct scenario {
+    const char *name;
+    struct step steps[MAX_STEPS];
+};
+
+#define WM(a) WAKE_MACHINE_##a
+#define DISARMED WAKE_MACHINE_DISARMED
+#define PENDING WAKE_MACHINE_ARM_PENDING
+#define ARMED WAKE_MACHINE_ARMED
+#define CYCLE (WM(RELEASE) | WM(ACQUIRE))
+#define WOKE (WM(EMIT_WAKE) | WM(RESET_WAKE) | WM(STOP_POLLING) | CYCLE | WM(WAKE))
+
+static const struct scenario scenarios[] = {
+    { "idle arms after the debounce", {
+        { EV_SETTINGS, 1, 0, 0, DISARMED },
+        { EV_IDLE, 1, 0, WM(SCHEDULE_ARM), PENDING },
+        { EV_ARM_TIMER, 0, DEBOUNCE_US - 1, WM(SCHEDULE_ARM), PENDING },
+        { EV_ARM_TIMER, 0, DEBOUNCE_US, CYCLE | WM(START_POLLING), ARMED },
+        { EV_IDLE, 0, DEBOUNCE_US + 1, WM(STOP_POLLING) | WM(RELEASE), DISARMED },
+    } },
+    { "idle flapping inside the debounce never arms", {
+        { EV_SETTINGS, 1, 0, 0, DISARMED },
+        { EV_IDLE, 1, 0, WM(SCHEDULE_ARM), PENDING },
+        { EV_IDLE, 0, 1000, WM(CANCEL_ARM), DISARMED },
+        { EV_ARM_TIMER, 0, DEBOUNCE_US, 0, DISARMED },
+    } },
+    { "nothing enabled never arms", {
+        { EV_IDLE, 1, 0, 0, DISARMED },
+        { EV_BLANK, 0, 0, 0, DISARMED },
+        { EV_PREPARE, 0, 0, 0, DISARMED },
+        { EV_SLEEP, 1, 0, 0, DISARMED },
+    } },
+    { "blank skips the debounce", {
+        { EV_SETTINGS, 1, 0, 0, DISARMED },
+        { EV_IDLE, 1, 0, WM(SCHEDULE_ARM), PENDING },
+        { EV_BLANK, 0, 10, WM(CANCEL_ARM) | CYCLE | WM(START_POLLING), ARMED },
+        { EV_BLANK, 0, 20, 0, ARMED },
+    } },
+    { "prepared sessions are reset instead of cycled", {
+        { EV_SETTINGS, 1, 0, 0, DISARMED },
+        { EV_PREPARE, 0, 0, CYCLE, DISARMED },
+        { EV_PREPARE, 0, 0, 0, DISARMED },
+        { EV_BLANK, 0, 0, WM(RESET_WAKE) | WM(RESET_TILT) | WM(START_POLLING), ARMED },
+    } },
+    { "a wake latch wakes once and re-acquires", {
+        { EV_SETTINGS, 1, 0, 0, DISARMED },
+        { EV_BLANK, 0, 0, CYCLE | WM(START_POLLING), ARMED },
+        { EV_WAKE, 5000000, 0, WOKE, DISARMED },
+        { EV_WAKE, 5000000, 0, 0, DISARMED },
+    } },
+    { "a proximity veto keeps polling and the dedup window open", {
+        { EV_SETTINGS, 1, 0, 0, DISARMED },
+        { EV_BLANK, 0, 0, CYCLE | WM(START_POLLING), ARMED },
+        { EV_WAKE, 5000000, 0, WOKE, DISARMED },
+        { EV_BLOCKED, 0, 0, WM(EMIT_WAKE) | WM(RESET_WAKE), ARMED },
+        { EV_WAKE, 5000001, 0, WOKE, DISARMED },
+    } },
+    { "listeners get latches without a wake", {
+        { EV_SETTINGS, 4, 0, 0, DISARMED },
+        { EV_BLANK, 0, 0, CYCLE | WM(START_POLLING), ARMED },
+        { EV_TILT, 7000000, 0, WM(EMIT_TILT) | WM(RESET_TILT), ARMED },
+    } },
+    { "input wakes only while idle or dark, deduplicated", {
+        { EV_SETTINGS, 1, 0, 0, DISARMED },
+        { EV_INPUT, 1000000, 0, 0, DISARMED },
+        { EV_IDLE, 1, 0, WM(SCHEDULE_ARM), PENDING },
+        { EV_INPUT, 2000000, 0, WM(WAKE), PENDING },
+        { EV_INPUT, 2500000, 0, 0, PENDING },
+        { EV_INPUT, 3000000, 0, WM(WAKE), PENDING },
+    } },
+    { "sensor and input wakes are deduplicated on their own clocks", {
+        { EV_SETTINGS, 1, 0, 0, DISARMED },
+        { EV_BLANK, 0, 0, CYCLE | WM(START_POLLING), ARMED },
+        { EV_WAKE, 5000000, 0, WOKE, DISARMED },
+        { EV_INPUT, 5000100, 0, WM(WAKE), DISARMED },
+        { EV_BLOCKED, 0, 0, 0, DISARMED },
+        { EV_INPUT, 5000200, 0, WM(WAKE), DISARMED },
+    } },
+    { "settings turned off release what an arm holds", {
+        { EV_SETTINGS, 1, 0, 0, DISARMED },
+        { EV_BLANK, 0, 0, CYCLE | WM(START_POLLING), ARMED },
+        { EV_SETTINGS, 0, 0, WM(STOP_POLLING) | WM(RELEASE), DISARMED },
+        { EV_SETTINGS, 1, 0, WM(SCHEDULE_ARM), PENDING },
+    } },
+    { "suspend arms ahead and resume restarts polling", {
+        { EV_SETTINGS, 1, 0, 0, DISARMED },
+        { EV_SLEEP, 1, 0, CYCLE | WM(STOP_POLLING) | WM(STANDBY), ARMED },
+        { EV_SLEEP, 0, 0, WM(START_POLLING), ARMED },
+        { EV_SCREEN, 1, 0, WM(STOP_POLLING), DISARMED },
+    } },
+};
+
+static unsigned int
+apply(struct wake_machine *wm, enum event event, uint64_t arg, uint64_t now, unsigned int last)
+{
+    struct wake_machine_reading reading = {0};
+
+    switch (event) {
+    case EV_SETTINGS:
+        return wake_machine_settings(wm, arg & 1, (arg >> 1) & 1, (arg >> 2) & 1, now);
+    case EV_IDLE:
+        return wake_machine_idle(wm, arg, now);
+    case EV_ARM_TIMER:
+        return wake_machine_arm_timer(wm, now);
+    case EV_BLANK:
+        return wake_machine_blank(wm);
+    case EV_PREPARE:
+        return wake_machine_prepare(wm);
+    case EV_SCREEN:
+        return wake_machine_screen(wm, arg);
+    case EV_WAKE:
+        reading.wake = 1;
+        reading.wake_timestamp = arg;
+        return wake_machine_reading(wm, &reading);
+    case EV_TILT:
+        reading.tilt = 1;
+        reading.tilt_timestamp = arg;
+        return wake_machine_reading(wm, &reading);
+    case EV_BLOCKED:
+        return wake_machine_blocked(wm, last);
+    case EV_INPUT:
+        return wake_machine_input(wm, arg);
+    case EV_SLEEP:
+        return wake_machine_sleep(wm, arg);
+    default:
+        return 0;
+    }
+}
+
+static int
+run_scenarios(void)
+{
+    const struct wake_machine_config config = { DEBOUNCE_US, DEDUP_US };
+    int failures = 0;
+
+    for (size_t i = 0; i < sizeof(scenarios) / sizeof(scenarios[0]); i++) {
+        const struct scenario *scenario = &scenarios[i];
+        struct wake_machine wm;
+        unsigned int actions = 0;
+
+        wake_machine_init(&wm, &config);
+        for (int s = 0; s < MAX_STEPS && scenario->steps[s].event != EV_END; s++) {
+            const struct step *step = &scenario->steps[s];
+
+            actions = apply(&wm, step->event, step->arg, step->now, actions);
+            if (actions != step->actions || wm.state != step->state) {
+                fprintf(stderr, "FAIL %s, step %d (%s): actions 0x%x state %d, expected 0x%x state %d\n",
+                        scenario->name, s, event_names[step->event], actions, wm.state,
+                        step->actions, step->state);
+                failures++;
+                break;
+            }
+        }
+    }
+
+    return failures;
+}
+
+static int
+wanted(const struct wake_machine *wm)
+{
+    return wm->wake_enabled || wm->tilt_enabled || wm->listening;
+}
+
+#define PROPERTY(cond, ...)                                              \
+    do {                                                                 \
+        if (!(cond)) {                                                   \
+            fprintf(stderr, "FAIL step %d (%s): ", step, event_names[event]); \
+            fprintf(stderr, __VA_ARGS__);                                \
+            fputc('\n', stderr);                                         \
+            return 1;                                                    \
+        }                                                                \
+    } while (0)
+
+// Random event streams on a clock that only moves forward. Sensor and input
+// timestamps are both taken from it, but each only dedups against wakes
+// from its own source.
+static int
+run_properties(void)
+{
+    const struct wake_machine_config config = { DEBOUNCE_US, DEDUP_US };
+    struct wake_machine wm;
+    unsigned int actions = 0;
+    uint32_t acquisitions = 0;
+    uint64_t now = 1, last_wake[WAKE_MACHINE_CLOCKS] = {0}, vetoable_wake[WAKE_MACHINE_CLOCKS] = {0};
+    int woke[WAKE_MACHINE_CLOCKS] = {0}, vetoable_woke[WAKE_MACHINE_CLOCKS] = {0};
+    enum wake_machine_clock last_clock = WAKE_MACHINE_CLOCK_SENSOR;
+
+    srand(1);
+    wake_machine_init(&wm, &config);
+
+    for (int step = 0; step < RANDOM_STEPS; step++) {
+        enum event event = 1 + rand() % (EV_COUNT - 1);
+        uint64_t arg = rand() % 8;
+        int was_idle = wm.idle, was_dark = wm.screen_off;
+        enum wake_machine_state before = wm.state;
+        unsigned int previous = actions;
+
+        now += rand() % (DEDUP_US / 2);
+        if (event == EV_WAKE || event == EV_TILT || event == EV_INPUT)
+            arg = now;
+
+        actions = apply(&wm, event, arg, now, actions);
+
+        // The machine counts every acquisition, a veto takes its own back.
+        // What a veto returns is the previous step's, already counted.
+        if (event == EV_BLOCKED) {
+            if ((previous & WM(ACQUIRE)) && !(actions & WM(ACQUIRE)))
+                acquisitions--;
+        } else if (actions & WM(ACQUIRE)) {
+            acquisitions++;
+        }
+        PROPERTY(wm.acquisitions == acquisitions, "%u acquisitions counted, machine has %u",
+                 acquisitions, wm.acquisitions);
+
+        // A veto only ever takes actions away, and vetoes only make sense
+        // right after a reading
+        if (event == EV_BLOCKED) {
+            PROPERTY(!(actions & ~previous) && !(actions & WM(WAKE)), "veto left 0x%x of 0x%x",
+                     actions, previous);
+            // The wake before the vetoed one is what dedups again
+            if (previous & WM(WAKE)) {
+                woke[last_clock] = vetoable_woke[last_clock];
+                last_wake[last_clock] = vetoable_wake[last_clock];
+            }
+            actions = 0;
+            continue;
+        }
+
+        PROPERTY(!(actions & WM(ACQUIRE)) || (actions & WM(RELEASE)),
+                 "acquire without release, 0x%x", actions);
+        PROPERTY(!(actions & WM(START_POLLING)) || wm.state == ARMED,
+                 "polling started in state %d", wm.state);
+        PROPERTY(!(actions & WM(SCHEDULE_ARM)) || wm.state == PENDING,
+                 "arm scheduled in state %d", wm.state);
+        PROPERTY(wm.state == DISARMED || wanted(&wm), "state %d with nothing enabled", wm.state);
+        // Suspend arms and stops polling in one go
+        PROPERTY(!(actions & WM(STOP_POLLING)) || before == ARMED || event == EV_SLEEP,
+                 "polling stopped from state %d", before);
+
+        if (actions & WM(WAKE)) {
+            enum wake_machine_clock clock = event == EV_INPUT ? WAKE_MACHINE_CLOCK_INPUT
+                                                              : WAKE_MACHINE_CLOCK_SENSOR;
+
+            PROPERTY(event == EV_WAKE || event == EV_TILT || event == EV_INPUT,
+                     "wake from a non-gesture event");
+            PROPERTY(event != EV_INPUT || was_idle || was_dark, "input wake while in use");
+            PROPERTY(!woke[clock] || arg - last_wake[clock] >= DEDUP_US,
+                     "second wake %" PRIu64 " us after the last on its clock", arg - last_wake[clock]);
+            vetoable_woke[clock] = woke[clock];
+            vetoable_wake[clock] = last_wake[clock];
+            woke[clock] = 1;
+            last_wake[clock] = arg;
+            last_clock = clock;
+        }
+    }
+
+    return 0;
+}
+
+static double
+now_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+// Five events per cycle: idle, arm timer, wake latch, screen on, idle end
+static void
+run_bench(void)
+{
+    const struct wake_machine_config config = { DEBOUNCE_US, DEDUP_US };
+    struct wake_machine_reading reading = { .wake = 1 };
+    struct wake_machine wm;
+    volatile unsigned int sink = 0;
+    uint64_t now = 1;
+
+    wake_machine_init(&wm, &config);
+    wake_machine_settings(&wm, 1, 1, 0, now);
+
+    double started = now_ns();
+    for (int i = 0; i < BENCH_CYCLES; i++) {
+        sink ^= wake_machine_idle(&wm, 1, now);
+        now += DEBOUNCE_US;
+        sink ^= wake_machine_arm_timer(&wm, now);
+        now += DEDUP_US;
+        reading.wake_timestamp = now;
+        sink ^= wake_machine_reading(&wm, &reading);
+        sink ^= wake_machine_screen(&wm, 1);
+        sink ^= wake_machine_idle(&wm, 0, now);
+    }
+    double elapsed = now_ns() - started;
+
+    printf("wake machine: %.1f ns/event over %d cycles\n", elapsed / (BENCH_CYCLES * 5.0), BENCH_CYCLES);
+}
+
+int
+main(void)
+{
+    int failures = run_scenarios();
+
+    failures += run_properties();
+    if (failures)
+        return 1;
+
+    printf("%zu scenarios, %d random steps passed\n", sizeof(scenarios) / sizeof(scenarios[0]), RANDOM_STEPS);
+    run_bench();
+    return 0;
+}
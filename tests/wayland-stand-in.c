@@ -0,0 +1,169 @@
+// SPDX-License-Identifier: MIT
+// Copyright (C) 2026 Bardia Moshiri <bardia@furilabs.com>
+
+#include <stdlib.h>
+#include <unistd.h>
+#include <wayland-server.h>
+#include "wayland-stand-in.h"
+
+// The protocol code is shared with the client, only the request handlers
+// are spelled out here, in the order the protocol lists them
+extern const struct wl_interface zwp_virtual_keyboard_v1_interface;
+extern const struct wl_interface zwp_virtual_keyboard_manager_v1_interface;
+
+struct virtual_keyboard_requests {
+    void (*keymap)(struct wl_client *client, struct wl_resource *resource,
+                   uint32_t format, int32_t fd, uint32_t size);
+    void (*key)(struct wl_client *client, struct wl_resource *resource,
+                uint32_t time, uint32_t key, uint32_t state);
+    void (*modifiers)(struct wl_client *client, struct wl_resource *resource,
+                      uint32_t depressed, uint32_t latched, uint32_t locked, uint32_t group);
+    void (*destroy)(struct wl_client *client, struct wl_resource *resource);
+};
+
+struct virtual_keyboard_manager_requests {
+    void (*create_virtual_keyboard)(struct wl_client *client, struct wl_resource *resource,
+                                    struct wl_resource *seat, uint32_t id);
+};
+
+// The fd is ours once the request arrives, leaking it would show up as
+// descriptor growth in the soak
+static void
+keyboard_keymap(struct wl_client *client, struct wl_resource *resource,
+                uint32_t format, int32_t fd, uint32_t size)
+{
+    WaylandStandIn *stand_in = wl_resource_get_user_data(resource);
+
+    close(fd);
+    g_atomic_int_inc(&stand_in->keymaps);
+}
+
+static void
+keyboard_key(struct wl_client *client, struct wl_resource *resource,
+             uint32_t time, uint32_t key, uint32_t state)
+{
+    WaylandStandIn *stand_in = wl_resource_get_user_data(resource);
+
+    if (state == WL_KEYBOARD_KEY_STATE_PRESSED)
+        g_atomic_int_inc(&stand_in->keys);
+}
+
+static void
+keyboard_modifiers(struct wl_client *client, struct wl_resource *resource,
+                   uint32_t depressed, uint32_t latched, uint32_t locked, uint32_t group)
+{
+}
+
+static void
+keyboard_destroy(struct wl_client *client, struct wl_resource *resource)
+{
+    wl_resource_destroy(resource);
+}
+
+static const struct virtual_keyboard_requests keyboard_requests = {
+    .keymap = keyboard_keymap,
+    .key = keyboard_key,
+    .modifiers = keyboard_modifiers,
+    .destroy = keyboard_destroy,
+};
+
+static void
+manager_create_virtual_keyboard(struct wl_client *client, struct wl_resource *resource,
+                                struct wl_resource *seat, uint32_t id)
+{
+    struct wl_resource *keyboard = wl_resource_create(client, &zwp_virtual_keyboard_v1_interface,
+                                                      wl_resource_get_version(resource), id);
+
+    if (!keyboard) {
+        wl_client_post_no_memory(client);
+        return;
+    }
+    wl_resource_set_implementation(keyboard, &keyboard_requests,
+                                   wl_resource_get_user_data(resource), NULL);
+}
+
+static const struct virtual_keyboard_manager_requests manager_requests = {
+    .create_virtual_keyboard = manager_create_virtual_keyboard,
+};
+
+static void
+bind_manager(struct wl_client *client, void *data, uint32_t version, uint32_t id)
+{
+    struct wl_resource *resource = wl_resource_create(client,
+                                                      &zwp_virtual_keyboard_manager_v1_interface,
+                                                      version, id);
+
+    if (!resource) {
+        wl_client_post_no_memory(client);
+        return;
+    }
+    wl_resource_set_implementation(resource, &manager_requests, data, NULL);
+}
+
+// The client only hands the seat to the manager, version 1 has no requests
+// it would send
+static void
+bind_seat(struct wl_client *client, void *data, uint32_t version, uint32_t id)
+{
+    struct wl_resource *resource = wl_resource_create(client, &wl_seat_interface, version, id);
+
+    if (!resource) {
+        wl_client_post_no_memory(client);
+        return;
+    }
+    wl_resource_set_implementation(resource, NULL, data, NULL);
+    wl_seat_send_capabilities(resource, WL_SEAT_CAPABILITY_KEYBOARD);
+}
+
+static gpointer
+wayland_stand_in_run(gpointer user_data)
+{
+    WaylandStandIn *stand_in = user_data;
+
+    wl_display_run(stand_in->display);
+
+    return NULL;
+}
+
+gboolean
+wayland_stand_in_start(WaylandStandIn *stand_in)
+{
+    const char *socket;
+
+    stand_in->display = wl_display_create();
+    if (!stand_in->display)
+        return FALSE;
+
+    socket = wl_display_add_socket_auto(stand_in->display);
+    if (!socket) {
+        g_printerr("Failed to add a Wayland socket, is XDG_RUNTIME_DIR set?\n");
+        wayland_stand_in_stop(stand_in);
+        return FALSE;
+    }
+
+    if (!wl_global_create(stand_in->display, &wl_seat_interface, 1, stand_in, bind_seat) ||
+        !wl_global_create(stand_in->display, &zwp_virtual_keyboard_manager_v1_interface, 1,
+                          stand_in, bind_manager)) {
+        wayland_stand_in_stop(stand_in);
+        return FALSE;
+    }
+
+    setenv("WAYLAND_DISPLAY", socket, 1);
+    stand_in->thread = g_thread_new("wayland-stand-in", wayland_stand_in_run, stand_in);
+    return TRUE;
+}
+
+void
+wayland_stand_in_stop(WaylandStandIn *stand_in)
+{
+    if (stand_in->thread) {
+        wl_display_terminate(stand_in->display);
+        g_thread_join(stand_in->thread);
+        stand_in->thread = NULL;
+    }
+    if (stand_in->display) {
+        wl_display_destroy_clients(stand_in->display);
+        wl_display_destroy(stand_in->display);
+        stand_in->display = NULL;
+    }
+}
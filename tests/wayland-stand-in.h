@@ -0,0 +1,26 @@
+// SPDX-License-Identifier: MIT
+// Copyright (C) 2026 Bardia Moshiri <bardia@furilabs.com>
+
+// A stand-in compositor for the wake soak. It listens on its own socket
+// under XDG_RUNTIME_DIR, points WAYLAND_DISPLAY at it and offers a seat and
+// the virtual keyboard manager, enough for the virtual keyboard wake
+// backend's whole handshake. Requests are served from its own thread.
+
+#ifndef WAYLAND_STAND_IN_H
+#define WAYLAND_STAND_IN_H
+
+#include <glib.h>
+
+struct wl_display;
+
+typedef struct {
+    struct wl_display *display;
+    GThread *thread;
+    gint keymaps; // keymap uploads, atomic
+    gint keys;    // key presses, atomic
+} WaylandStandIn;
+
+gboolean wayland_stand_in_start(WaylandStandIn *stand_in);
+void wayland_stand_in_stop(WaylandStandIn *stand_in);
+
+#endif // WAYLAND_STAND_IN_H
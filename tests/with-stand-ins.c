@@ -0,0 +1,69 @@
+// SPDX-License-Identifier: MIT
+// Copyright (C) 2026 Bardia Moshiri <bardia@furilabs.com>
+
+// Runs a command with the sensorfw stand-in owning its name on a private
+// bus, which DBUS_SYSTEM_BUS_ADDRESS points at, and WAYLAND_DISPLAY pointing
+// at the stand-in compositor. make release trains the daemon and the wake
+// module this way. Exits with the command's status, 77 without a
+// dbus-daemon for the private bus or XDG_RUNTIME_DIR for the compositor
+// socket.
+//
+// usage: with-stand-ins COMMAND [ARGS...]
+
+#include <sys/wait.h>
+#include "sensorfw-stand-in.h"
+#include "wayland-stand-in.h"
+
+int
+main(int argc, char **argv)
+{
+    StandIn sensorfw = { 0 };
+    WaylandStandIn compositor = { 0 };
+    GTestDBus *bus;
+    GError *error = NULL;
+    gchar *daemon;
+    gint status = 1;
+
+    if (argc < 2) {
+        g_printerr("usage: %s COMMAND [ARGS...]\n", argv[0]);
+        return 1;
+    }
+
+    daemon = g_find_program_in_path("dbus-daemon");
+    if (!daemon) {
+        g_printerr("No dbus-daemon for the private bus\n");
+        return 77;
+    }
+    g_free(daemon);
+    if (!g_getenv("XDG_RUNTIME_DIR")) {
+        g_printerr("No XDG_RUNTIME_DIR for the compositor socket\n");
+        return 77;
+    }
+
+    bus = g_test_dbus_new(G_TEST_DBUS_NONE);
+    g_test_dbus_up(bus);
+
+    if (!stand_in_start(&sensorfw, g_test_dbus_get_bus_address(bus)) ||
+        !wayland_stand_in_start(&compositor)) {
+        g_printerr("Failed to start the stand-ins\n");
+        goto out;
+    }
+    g_setenv("DBUS_SYSTEM_BUS_ADDRESS", g_test_dbus_get_bus_address(bus), TRUE);
+
+    if (!g_spawn_sync(NULL, argv + 1, NULL, G_SPAWN_SEARCH_PATH | G_SPAWN_CHILD_INHERITS_STDIN,
+                      NULL, NULL, NULL, NULL, &status, &error)) {
+        g_printerr("Failed to run %s: %s\n", argv[1], error->message);
+        g_error_free(error);
+        status = 1;
+        goto out;
+    }
+    status = WIFEXITED(status) ? WEXITSTATUS(status) : 1;
+
+out:
+    wayland_stand_in_stop(&compositor);
+    stand_in_stop(&sensorfw);
+    g_test_dbus_down(bus);
+    g_object_unref(bus);
+
+    return status;
+}
@@ -0,0 +1,310 @@
+// SPDX-License-Identifier: MIT
+// Copyright (C) 2026 Bardia Moshiri <bardia@furilabs.com>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include "trace.h"
+
+_Static_assert(sizeof(struct trace_header) == 16, "trace header must stay 16 bytes");
+_Static_assert(sizeof(struct trace_record) == 32, "trace records must stay 32 bytes");
+
+// Always on flight recorder, every trace record also lands here whether or
+// not a trace file is being written
+static struct {
+    struct trace_record records[TRACE_RING_SIZE];
+    size_t head;
+    size_t count;
+} ring;
+
+static int
+write_all(int fd, const void *buf, size_t len)
+{
+    const char *p = buf;
+
+    while (len > 0) {
+        ssize_t n = write(fd, p, len);
+        if (n < 0) {
+            if (errno == EINTR)
+                continue;
+            return -1;
+        }
+        p += n;
+        len -= n;
+    }
+
+    return 0;
+}
+
+static int
+header_valid(const struct trace_header *header)
+{
+    return memcmp(header->magic, TRACE_MAGIC, sizeof(header->magic)) == 0 &&
+           header->version == TRACE_VERSION &&
+           header->record_size == sizeof(struct trace_record);
+}
+
+int
+trace_writer_open(struct trace_writer *writer, const char *path)
+{
+    struct trace_header existing;
+    struct stat st;
+
+    writer->fd = open(path, O_RDWR | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+    if (writer->fd < 0)
+        return -1;
+
+    if (fstat(writer->fd, &st) < 0)
+        goto fail;
+
+    // Appending to an existing log keeps its header, a new one gets ours
+    if (st.st_size == 0) {
+        struct trace_header header = {
+            .version = TRACE_VERSION,
+            .record_size = sizeof(struct trace_record),
+        };
+        memcpy(header.magic, TRACE_MAGIC, sizeof(header.magic));
+        if (write_all(writer->fd, &header, sizeof(header)) < 0)
+            goto fail;
+    } else if ((size_t)st.st_size < sizeof(existing) ||
+               (st.st_size - sizeof(existing)) % sizeof(struct trace_record) != 0 ||
+               pread(writer->fd, &existing, sizeof(existing), 0) != sizeof(existing) ||
+               !header_valid(&existing)) {
+        // Only ever append to a log the reader would accept
+        errno = EINVAL;
+        goto fail;
+    }
+
+    return 0;
+
+fail:
+    close(writer->fd);
+    writer->fd = -1;
+    return -1;
+}
+
+int
+trace_writer_append(struct trace_writer *writer, const struct trace_record *record)
+{
+    if (writer->fd < 0)
+        return -1;
+
+    // One write per record so a crash never leaves a torn entry behind
+    return write_all(writer->fd, record, sizeof(*record));
+}
+
+void
+trace_writer_close(struct trace_writer *writer)
+{
+    if (writer->fd >= 0)
+        close(writer->fd);
+    writer->fd = -1;
+}
+
+int
+trace_reader_open(struct trace_reader *reader, const char *path)
+{
+    const struct trace_header *header;
+    struct stat st;
+    int fd;
+
+    memset(reader, 0, sizeof(*reader));
+
+    fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+        return -1;
+
+    if (fstat(fd, &st) < 0 || (size_t)st.st_size < sizeof(struct trace_header)) {
+        close(fd);
+        errno = EINVAL;
+        return -1;
+    }
+
+    reader->map_size = st.st_size;
+    reader->map = mmap(NULL, reader->map_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (reader->map == MAP_FAILED) {
+        reader->map = NULL;
+        return -1;
+    }
+
+    header = reader->map;
+    if (!header_valid(header)) {
+        trace_reader_close(reader);
+        errno = EINVAL;
+        return -1;
+    }
+
+    madvise(reader->map, reader->map_size, MADV_SEQUENTIAL);
+
+    reader->records = (const struct trace_record *)(header + 1);
+    reader->count = (reader->map_size - sizeof(*header)) / sizeof(struct trace_record);
+
+    return 0;
+}
+
+void
+trace_reader_close(struct trace_reader *reader)
+{
+    if (reader->map)
+        munmap(reader->map, reader->map_size);
+    memset(reader, 0, sizeof(*reader));
+}
+
+void
+trace_log_record(const struct trace_record *record)
+{
+    ring.records[ring.head] = *record;
+    ring.head = (ring.head + 1) % TRACE_RING_SIZE;
+    if (ring.count < TRACE_RING_SIZE)
+        ring.count++;
+}
+
+// No formatting and no allocation, a record is a clock read and a 32 byte copy
+void
+trace_log(uint16_t type, uint64_t timestamp, int32_t v0, int32_t v1, int32_t v2)
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    struct trace_record record = {
+        .time = (uint64_t)now.tv_sec * 1000000 + now.tv_nsec / 1000,
+        .timestamp = timestamp,
+        .type = type,
+        .value = { v0, v1, v2 },
+    };
+
+    trace_log_record(&record);
+}
+
+// Writes the ring oldest first as a regular trace, so a dump can be decoded
+// with gesture-trace or fed to --replay like a recording
+int
+trace_log_dump(const char *path)
+{
+    struct trace_header header = {
+        .version = TRACE_VERSION,
+        .record_size = sizeof(struct trace_record),
+    };
+    size_t start = (ring.head + TRACE_RING_SIZE - ring.count) % TRACE_RING_SIZE;
+    size_t first = ring.count < TRACE_RING_SIZE - start ? ring.count : TRACE_RING_SIZE - start;
+    struct iovec iov[3] = {
+        { &header, sizeof(header) },
+        { &ring.records[start], first * sizeof(struct trace_record) },
+        { &ring.records[0], (ring.count - first) * sizeof(struct trace_record) },
+    };
+    size_t total = iov[0].iov_len + iov[1].iov_len + iov[2].iov_len;
+    int fd;
+
+    memcpy(header.magic, TRACE_MAGIC, sizeof(header.magic));
+
+    fd = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0)
+        return -1;
+
+    ssize_t n = writev(fd, iov, 3);
+    if (n >= 0 && (size_t)n < total) {
+        errno = EIO;
+        n = -1;
+    }
+
+    close(fd);
+
+    return n < 0 ? -1 : 0;
+}
+
+const char *
+trace_record_name(uint16_t type)
+{
+    switch (type) {
+    case TRACE_RECORD_WAKE:
+        return "wake";
+    case TRACE_RECORD_TILT:
+        return "tilt";
+    case TRACE_RECORD_ACCEL:
+        return "accel";
+    case TRACE_RECORD_IDLE_HINT:
+        return "idle-hint";
+    case TRACE_RECORD_SCREEN:
+        return "screen";
+    case TRACE_RECORD_PROXIMITY:
+        return "proximity";
+    case TRACE_RECORD_INPUT:
+        return "input";
+    case TRACE_RECORD_WAKE_PATH:
+        return "wake-path";
+    case TRACE_RECORD_WAKE_ACTION:
+        return "wake-action";
+    case TRACE_RECORD_SYSFS_WRITE:
+        return "sysfs-write";
+    case TRACE_RECORD_ARM:
+        return "arm";
+    case TRACE_RECORD_STARTUP:
+        return "startup";
+    case TRACE_RECORD_SENSORFW:
+        return "sensorfw";
+    case TRACE_RECORD_WAKE_OUTCOME:
+        return "wake-outcome";
+    case TRACE_RECORD_RESIDENT:
+        return "resident";
+    case TRACE_RECORD_WAKE_MODULE:
+        return "wake-module";
+    case TRACE_RECORD_ARM_GAP:
+        return "arm-gap";
+    default:
+        return "unknown";
+    }
+}
+
+static const char *const sensorfw_methods[TRACE_SENSORFW_METHODS] = {
+    [TRACE_SENSORFW_OTHER] = "other",
+    [TRACE_SENSORFW_LOAD_PLUGIN] = "loadPlugin",
+    [TRACE_SENSORFW_REQUEST_SENSOR] = "requestSensor",
+    [TRACE_SENSORFW_START] = "start",
+    [TRACE_SENSORFW_STOP] = "stop",
+    [TRACE_SENSORFW_RELEASE_SENSOR] = "releaseSensor",
+    [TRACE_SENSORFW_GET] = "Get",
+    [TRACE_SENSORFW_RESET_WAKE_GESTURE] = "resetWakeGesture",
+    [TRACE_SENSORFW_RESET_TILT_DETECTOR] = "resetTiltDetector",
+    [TRACE_SENSORFW_SET_INTERVAL] = "setInterval",
+    [TRACE_SENSORFW_SET_STANDBY_OVERRIDE] = "setStandbyOverride",
+};
+
+// Records keep a small id instead of the method string
+int32_t
+trace_sensorfw_method(const char *name)
+{
+    for (int32_t method = 1; method < TRACE_SENSORFW_METHODS; method++)
+        if (strcmp(sensorfw_methods[method], name) == 0)
+            return method;
+
+    return TRACE_SENSORFW_OTHER;
+}
+
+const char *
+trace_sensorfw_method_name(int32_t method)
+{
+    if (method < 0 || method >= TRACE_SENSORFW_METHODS)
+        return sensorfw_methods[TRACE_SENSORFW_OTHER];
+
+    return sensorfw_methods[method];
+}
+
+const char *
+trace_arm_trigger_name(int32_t trigger)
+{
+    switch (trigger) {
+    case TRACE_ARM_TRIGGER_IDLE_HINT:
+        return "idle-hint";
+    case TRACE_ARM_TRIGGER_OUTPUT_OFF:
+        return "output-off";
+    default:
+        return "unknown";
+    }
+}
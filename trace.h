@@ -0,0 +1,104 @@
+// SPDX-License-Identifier: MIT
+// Copyright (C) 2026 Bardia Moshiri <bardia@furilabs.com>
+
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define TRACE_MAGIC "GSTR"
+#define TRACE_VERSION 1
+
+// In-memory event log, 1024 records is 32 KiB of history
+#define TRACE_RING_SIZE 1024
+#define TRACE_LOG_DUMP_NAME "gesture-sensors-events.trace"
+
+enum trace_record_type {
+    TRACE_RECORD_WAKE = 1,          // value[0] = wakegesture reading
+    TRACE_RECORD_TILT = 2,          // value[0] = tiltdetector reading
+    TRACE_RECORD_ACCEL = 3,         // value[0..2] = x, y, z in mG
+    TRACE_RECORD_IDLE_HINT = 4,     // value[0] = IdleHint
+    TRACE_RECORD_SCREEN = 5,        // value[0] = 1 when the screen is on
+    TRACE_RECORD_PROXIMITY = 6,     // value[0] = proximity reading, non-zero when covered, value[1] = us taken, value[2] = 1 if sampled during the check
+    TRACE_RECORD_INPUT = 7,         // value[0] = evdev wake key code
+    TRACE_RECORD_WAKE_PATH = 8,     // value[0] = detection to wake in us, value[1] = boosted, value[2] = backend
+    TRACE_RECORD_WAKE_ACTION = 9,   // value[0] = backend, value[1] = elapsed us, value[2] = 1 on success
+    TRACE_RECORD_SYSFS_WRITE = 10,  // value[0] = errno or 0, value[1] = first byte written
+    TRACE_RECORD_ARM = 11,          // value[0] = wake machine state, value[1] = actions
+    TRACE_RECORD_STARTUP = 12,      // value[0] = us from process start to ready to arm, value[1] = sensors held, value[2] = KiB resident
+    TRACE_RECORD_SENSORFW = 13,     // value[0] = sensorfw method, value[1] = round trip in us, value[2] = 1 on success
+    TRACE_RECORD_WAKE_OUTCOME = 14, // value[0] = wake sources, value[1] = 1 if unused, value[2] = tilt pause in s
+    TRACE_RECORD_RESIDENT = 15,     // value[0] = KiB locked, 0 once unlocked, value[1] = errno or 0, value[2] = us taken
+    TRACE_RECORD_WAKE_MODULE = 16,  // value[0] = us to load, value[1] = 1 on success, value[2] = KiB resident after
+    TRACE_RECORD_ARM_GAP = 17,      // value[0] = us from screen off to sensors armed, value[1] = trigger, value[2] = 1 if prepared
+};
+
+// Where the screen off time of an arm gap came from. IdleHint stands in
+// when the compositor does not publish the output power state.
+enum trace_arm_trigger {
+    TRACE_ARM_TRIGGER_IDLE_HINT = 0,
+    TRACE_ARM_TRIGGER_OUTPUT_OFF,
+    TRACE_ARM_TRIGGERS,
+};
+
+enum trace_sensorfw_method {
+    TRACE_SENSORFW_OTHER = 0,
+    TRACE_SENSORFW_LOAD_PLUGIN,
+    TRACE_SENSORFW_REQUEST_SENSOR,
+    TRACE_SENSORFW_START,
+    TRACE_SENSORFW_STOP,
+    TRACE_SENSORFW_RELEASE_SENSOR,
+    TRACE_SENSORFW_GET,
+    TRACE_SENSORFW_RESET_WAKE_GESTURE,
+    TRACE_SENSORFW_RESET_TILT_DETECTOR,
+    TRACE_SENSORFW_SET_INTERVAL,
+    TRACE_SENSORFW_SET_STANDBY_OVERRIDE,
+    TRACE_SENSORFW_METHODS,
+};
+
+// Both structs are fixed size and 8 byte aligned so a log can be mapped and
+// walked as a plain array
+struct trace_header {
+    char magic[4];
+    uint32_t version;
+    uint32_t record_size;
+    uint32_t reserved;
+};
+
+struct trace_record {
+    uint64_t time;      // daemon monotonic clock, us
+    uint64_t timestamp; // sensorfw timestamp, 0 for state changes
+    uint16_t type;
+    uint16_t reserved;
+    int32_t value[3];
+};
+
+struct trace_writer {
+    int fd;
+};
+
+struct trace_reader {
+    void *map;
+    size_t map_size;
+    const struct trace_record *records;
+    size_t count;
+};
+
+int trace_writer_open(struct trace_writer *writer, const char *path);
+int trace_writer_append(struct trace_writer *writer, const struct trace_record *record);
+void trace_writer_close(struct trace_writer *writer);
+
+int trace_reader_open(struct trace_reader *reader, const char *path);
+void trace_reader_close(struct trace_reader *reader);
+
+void trace_log(uint16_t type, uint64_t timestamp, int32_t v0, int32_t v1, int32_t v2);
+void trace_log_record(const struct trace_record *record);
+int trace_log_dump(const char *path);
+
+const char *trace_record_name(uint16_t type);
+int32_t trace_sensorfw_method(const char *name);
+const char *trace_sensorfw_method_name(int32_t method);
+const char *trace_arm_trigger_name(int32_t trigger);
+
+#endif // TRACE_H
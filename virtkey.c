@@ -2,6 +2,10 @@
 // Copyright (c) 2019 Josef Gajdusek
 // Copyright (C) 2023 Bardia Moshiri <fakeshell@bardia.tech>
 
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/ioctl.h>
+#include <linux/uinput.h>
 #include "virtkey.h"
 
 const struct wl_registry_listener registry_listener = {
@@ -38,16 +42,118 @@ enum wtype_mod name_to_mod(const char *name)
     return WTYPE_MOD_NONE;
 }
 
+static size_t keymap_hash(uint32_t key, size_t cap)
+{
+    return (key * 2654435761u) & (cap - 1);
+}
+
+static uint32_t keymap_index_find(const struct wtype *wtype,
+                                  const struct keymap_index *index,
+                                  uint32_t key, int by_wchr)
+{
+    if (!index->cap)
+        return 0;
+
+    for (size_t i = keymap_hash(key, index->cap);; i = (i + 1) & (index->cap - 1)) {
+        uint32_t slot = index->slots[i];
+        if (!slot)
+            return 0;
+
+        const struct keymap_entry *entry = &wtype->keymap[slot - 1];
+        if ((by_wchr ? (uint32_t)entry->wchr : entry->xkb) == key)
+            return slot;
+    }
+}
+
+// First entry wins, like the linear scan this replaced
+static void keymap_index_insert(const struct wtype *wtype,
+                                struct keymap_index *index,
+                                uint32_t key, int by_wchr, uint32_t slot)
+{
+    for (size_t i = keymap_hash(key, index->cap);; i = (i + 1) & (index->cap - 1)) {
+        uint32_t other = index->slots[i];
+        if (!other) {
+            index->slots[i] = slot;
+            return;
+        }
+
+        const struct keymap_entry *entry = &wtype->keymap[other - 1];
+        if ((by_wchr ? (uint32_t)entry->wchr : entry->xkb) == key)
+            return;
+    }
+}
+
+static int keymap_index_rebuild(struct wtype *wtype, size_t cap)
+{
+    uint32_t *xkb_slots = calloc(cap, sizeof(uint32_t));
+    uint32_t *wchr_slots = calloc(cap, sizeof(uint32_t));
+    if (!xkb_slots || !wchr_slots) {
+        free(xkb_slots);
+        free(wchr_slots);
+        return -1;
+    }
+
+    free(wtype->xkb_index.slots);
+    free(wtype->wchr_index.slots);
+    wtype->xkb_index = (struct keymap_index){ xkb_slots, cap };
+    wtype->wchr_index = (struct keymap_index){ wchr_slots, cap };
+
+    for (size_t i = 0; i < wtype->keymap_len; i++) {
+        keymap_index_insert(wtype, &wtype->xkb_index, wtype->keymap[i].xkb, 0, i + 1);
+        if (wtype->keymap[i].wchr)
+            keymap_index_insert(wtype, &wtype->wchr_index, wtype->keymap[i].wchr, 1, i + 1);
+    }
+
+    return 0;
+}
+
+// Returns WTYPE_KEY_CODE_NONE with wtype->error set to ENOMEM when the
+// keymap or its indexes cannot grow
 unsigned int append_keymap_entry(struct wtype *wtype, wchar_t ch, xkb_keysym_t xkb)
 {
-    wtype->keymap = realloc(
-        wtype->keymap, ++wtype->keymap_len * sizeof(wtype->keymap[0])
-    );
-    wtype->keymap[wtype->keymap_len - 1].wchr = ch;
-    wtype->keymap[wtype->keymap_len - 1].xkb = xkb;
+    if (wtype->keymap_len == wtype->keymap_cap) {
+        size_t cap = wtype->keymap_cap ? wtype->keymap_cap * 2 : 16;
+        struct keymap_entry *keymap = realloc(wtype->keymap, cap * sizeof(wtype->keymap[0]));
+        if (!keymap) {
+            wtype->error = ENOMEM;
+            return WTYPE_KEY_CODE_NONE;
+        }
+        wtype->keymap = keymap;
+        wtype->keymap_cap = cap;
+    }
+
+    wtype->keymap[wtype->keymap_len].wchr = ch;
+    wtype->keymap[wtype->keymap_len].xkb = xkb;
+    wtype->keymap_len++;
+
+    // Keep both indexes at most half full
+    if (wtype->keymap_len * 2 > wtype->xkb_index.cap) {
+        if (keymap_index_rebuild(wtype, wtype->xkb_index.cap ? wtype->xkb_index.cap * 2 : 32) < 0) {
+            wtype->keymap_len--;
+            wtype->error = ENOMEM;
+            return WTYPE_KEY_CODE_NONE;
+        }
+    } else {
+        keymap_index_insert(wtype, &wtype->xkb_index, xkb, 0, wtype->keymap_len);
+        if (ch)
+            keymap_index_insert(wtype, &wtype->wchr_index, ch, 1, wtype->keymap_len);
+    }
+
     return wtype->keymap_len;
 }
 
+void wtype_free_keymap(struct wtype *wtype)
+{
+    free(wtype->keymap);
+    free(wtype->xkb_index.slots);
+    free(wtype->wchr_index.slots);
+    wtype->keymap = NULL;
+    wtype->keymap_len = 0;
+    wtype->keymap_cap = 0;
+    wtype->xkb_index = (struct keymap_index){ NULL, 0 };
+    wtype->wchr_index = (struct keymap_index){ NULL, 0 };
+}
+
 unsigned int get_key_code_by_wchar(struct wtype *wtype, wchar_t ch)
 {
     const struct {
@@ -58,11 +164,9 @@ unsigned int get_key_code_by_wchar(struct wtype *wtype, wchar_t ch)
         { L'\t', XKB_KEY_Tab },
         { L'\e', XKB_KEY_Escape },
     };
-    for (unsigned int i = 0; i < wtype->keymap_len; i++) {
-        if (wtype->keymap[i].wchr == ch) {
-            return i + 1;
-        }
-    }
+    uint32_t slot = ch ? keymap_index_find(wtype, &wtype->wchr_index, ch, 1) : 0;
+    if (slot)
+        return slot;
 
     xkb_keysym_t xkb = xkb_utf32_to_keysym(ch);
     for (size_t i = 0; i < ARRAY_SIZE(remap_table); i++) {
@@ -72,19 +176,57 @@ unsigned int get_key_code_by_wchar(struct wtype *wtype, wchar_t ch)
         }
     }
 
+    // The uinput device only has the keys in uinput_keys, anything else has
+    // no evdev code
+    if (wtype->uinput_fd >= 0)
+        return get_key_code_by_xkb(wtype, xkb);
+
     return append_keymap_entry(wtype, ch, xkb);
 }
 
 unsigned int get_key_code_by_xkb(struct wtype *wtype, xkb_keysym_t xkb)
 {
-    for (unsigned int i = 0; i < wtype->keymap_len; i++) {
-        if (wtype->keymap[i].xkb == xkb)
-            return i + 1;
+    if (wtype->uinput_fd >= 0) {
+        for (size_t i = 0; i < ARRAY_SIZE(uinput_keys); i++) {
+            if (uinput_keys[i].xkb == xkb)
+                return uinput_keys[i].code;
+        }
+        return WTYPE_KEY_CODE_NONE;
     }
 
+    uint32_t slot = keymap_index_find(wtype, &wtype->xkb_index, xkb, 0);
+    if (slot)
+        return slot;
+
     return append_keymap_entry(wtype, 0, xkb);
 }
 
+// value follows EV_KEY (1 press, 0 release), 2 sends a full press/release
+static void uinput_write_keys(struct wtype *wtype, const unsigned int *codes,
+                              size_t n_codes, int value)
+{
+    struct input_event events[8];
+    size_t n = 0;
+
+    for (size_t i = 0; i < n_codes && n + 2 <= ARRAY_SIZE(events); i++) {
+        if (value != 0) {
+            events[n++] = (struct input_event){ .type = EV_KEY, .code = codes[i], .value = 1 };
+            events[n++] = (struct input_event){ .type = EV_SYN, .code = SYN_REPORT };
+        }
+        if (value != 1) {
+            events[n++] = (struct input_event){ .type = EV_KEY, .code = codes[i], .value = 0 };
+            events[n++] = (struct input_event){ .type = EV_SYN, .code = SYN_REPORT };
+        }
+    }
+
+    // A whole press/release batch goes out in one write()
+    ssize_t written = write(wtype->uinput_fd, events, n * sizeof(events[0]));
+    if (written < 0)
+        wtype->error = errno;
+    else if ((size_t)written != n * sizeof(events[0]))
+        wtype->error = EIO;
+}
+
 void run_mod(struct wtype *wtype, struct wtype_command *cmd)
 {
     if (cmd->type == WTYPE_COMMAND_MOD_PRESS)
@@ -92,6 +234,15 @@ void run_mod(struct wtype *wtype, struct wtype_command *cmd)
     else
         wtype->mod_status &= ~cmd->mod;
 
+    if (wtype->uinput_fd >= 0) {
+        for (size_t i = 0; i < ARRAY_SIZE(uinput_mods); i++) {
+            if (uinput_mods[i].mod == cmd->mod)
+                uinput_write_keys(wtype, &uinput_mods[i].code, 1,
+                                  cmd->type == WTYPE_COMMAND_MOD_PRESS);
+        }
+        return;
+    }
+
     zwp_virtual_keyboard_v1_modifiers(
         wtype->keyboard, wtype->mod_status & ~WTYPE_MOD_CAPSLOCK, 0,
         wtype->mod_status & WTYPE_MOD_CAPSLOCK, 0
@@ -102,6 +253,12 @@ void run_mod(struct wtype *wtype, struct wtype_command *cmd)
 
 void run_key(struct wtype *wtype, struct wtype_command *cmd)
 {
+    if (wtype->uinput_fd >= 0) {
+        uinput_write_keys(wtype, &cmd->single_key_code, 1,
+                          cmd->type == WTYPE_COMMAND_KEY_PRESS);
+        return;
+    }
+
     zwp_virtual_keyboard_v1_key(
         wtype->keyboard, 0, cmd->single_key_code,
         cmd->type == WTYPE_COMMAND_KEY_PRESS ?
@@ -112,6 +269,11 @@ void run_key(struct wtype *wtype, struct wtype_command *cmd)
 
 void type_keycode(struct wtype *wtype, unsigned int key_code)
 {
+    if (wtype->uinput_fd >= 0) {
+        uinput_write_keys(wtype, &key_code, 1, 2);
+        return;
+    }
+
     zwp_virtual_keyboard_v1_key(
         wtype->keyboard, 0, key_code, WL_KEYBOARD_KEY_STATE_PRESSED
     );
@@ -124,11 +286,23 @@ void type_keycode(struct wtype *wtype, unsigned int key_code)
     usleep(2000);
 }
 
+// A text with a character the backend cannot type is refused as a whole
+// rather than typed with gaps
 void run_text(struct wtype *wtype, struct wtype_command *cmd)
 {
+    for (size_t i = 0; i < cmd->key_codes_len; i++) {
+        if (cmd->key_codes[i] == WTYPE_KEY_CODE_NONE) {
+            if (!wtype->error)
+                wtype->error = EINVAL;
+            return;
+        }
+    }
+
     for (size_t i = 0; i < cmd->key_codes_len; i++) {
         type_keycode(wtype, cmd->key_codes[i]);
-        usleep(cmd->delay_ms * 1000);
+        // usleep(0) still costs the timer slack, ~50 us per key
+        if (cmd->delay_ms)
+            usleep(cmd->delay_ms * 1000);
     }
 }
 
@@ -159,15 +333,21 @@ void print_keysym_name(xkb_keysym_t keysym, FILE *f)
     fprintf(f, "%s", sym_name);
 }
 
-void upload_keymap(struct wtype *wtype)
+int upload_keymap(struct wtype *wtype)
 {
     char filename[] = "/tmp/wtype-XXXXXX";
     int fd = mkstemp(filename);
-    if (fd < 0)
+    if (fd < 0) {
         printf("Failed to create the temporary keymap file");
+        return -1;
+    }
 
     unlink(filename);
     FILE *f = fdopen(fd, "w");
+    if (!f) {
+        close(fd);
+        return -1;
+    }
 
     fprintf(f, "xkb_keymap {\n");
 
@@ -207,4 +387,98 @@ void upload_keymap(struct wtype *wtype)
     wl_display_roundtrip(wtype->display);
 
     fclose(f);
+    return 0;
+}
+
+int uinput_open(struct wtype *wtype, const char *name)
+{
+    struct uinput_setup setup = {
+        .id = {
+            .bustype = BUS_VIRTUAL,
+            .vendor = 0x1234,
+            .product = 0x5678,
+        },
+    };
+    int fd;
+
+    strncpy(setup.name, name, UINPUT_MAX_NAME_SIZE - 1);
+
+    fd = open("/dev/uinput", O_WRONLY | O_NONBLOCK | O_CLOEXEC);
+    if (fd < 0)
+        return -1;
+
+    if (ioctl(fd, UI_SET_EVBIT, EV_KEY) < 0)
+        goto fail;
+    for (size_t i = 0; i < ARRAY_SIZE(uinput_keys); i++) {
+        if (ioctl(fd, UI_SET_KEYBIT, uinput_keys[i].code) < 0)
+            goto fail;
+    }
+    for (size_t i = 0; i < ARRAY_SIZE(uinput_mods); i++) {
+        if (ioctl(fd, UI_SET_KEYBIT, uinput_mods[i].code) < 0)
+            goto fail;
+    }
+    if (ioctl(fd, UI_DEV_SETUP, &setup) < 0 || ioctl(fd, UI_DEV_CREATE) < 0)
+        goto fail;
+
+    wtype->uinput_fd = fd;
+    return 0;
+
+fail:
+    close(fd);
+    return -1;
+}
+
+void uinput_close(struct wtype *wtype)
+{
+    if (wtype->uinput_fd < 0)
+        return;
+
+    ioctl(wtype->uinput_fd, UI_DEV_DESTROY);
+    close(wtype->uinput_fd);
+    wtype->uinput_fd = -1;
+}
+
+int wtype_arena_init(struct wtype_arena *arena, size_t size)
+{
+    arena->base = malloc(size);
+    arena->size = arena->base ? size : 0;
+    arena->used = 0;
+    return arena->base ? 0 : -1;
+}
+
+void *wtype_arena_alloc(struct wtype_arena *arena, size_t size)
+{
+    size_t offset = (arena->used + _Alignof(max_align_t) - 1) & ~(_Alignof(max_align_t) - 1);
+
+    if (offset > arena->size || size > arena->size - offset)
+        return NULL;
+
+    arena->used = offset + size;
+    return arena->base + offset;
+}
+
+void wtype_arena_reset(struct wtype_arena *arena)
+{
+    arena->used = 0;
+}
+
+void wtype_arena_free(struct wtype_arena *arena)
+{
+    free(arena->base);
+    arena->base = NULL;
+    arena->size = 0;
+    arena->used = 0;
+}
+
+struct wtype_command *wtype_alloc_commands(struct wtype *wtype, size_t count)
+{
+    struct wtype_command *commands = wtype_arena_alloc(&wtype->arena, count * sizeof(commands[0]));
+    if (commands)
+        memset(commands, 0, count * sizeof(commands[0]));
+    return commands;
+}
+
+unsigned int *wtype_alloc_key_codes(struct wtype *wtype, size_t count)
+{
+    return wtype_arena_alloc(&wtype->arena, count * sizeof(unsigned int));
 }
@@ -9,10 +9,15 @@
 #include <string.h>
 #include <unistd.h>
 #include <xkbcommon/xkbcommon.h>
+#include <linux/input-event-codes.h>
 #include "virtual-keyboard-unstable-v1-client-protocol.h"
 
 #define ARRAY_SIZE(x) (sizeof(x) / sizeof(x[0]))
 
+// Keymap codes are index + 1 and KEY_RESERVED is 0, so 0 is never a key.
+// get_key_code_by_*() return it for a character they cannot type.
+#define WTYPE_KEY_CODE_NONE 0
+
 enum wtype_command_type {
     WTYPE_COMMAND_TEXT = 0,
     WTYPE_COMMAND_MOD_PRESS = 1,
@@ -50,6 +55,19 @@ struct keymap_entry {
     wchar_t wchr;
 };
 
+// Open addressing table of keymap index + 1 (0 marks an empty slot)
+struct keymap_index {
+    uint32_t *slots;
+    size_t cap;
+};
+
+// Bump allocator for command lists, reset between runs instead of freed
+struct wtype_arena {
+    char *base;
+    size_t size;
+    size_t used;
+};
+
 struct wtype {
     struct wl_display *display;
     struct wl_registry *registry;
@@ -58,11 +76,38 @@ struct wtype {
     struct zwp_virtual_keyboard_v1 *keyboard;
 
     size_t keymap_len;
+    size_t keymap_cap;
     struct keymap_entry *keymap;
+    struct keymap_index xkb_index;
+    struct keymap_index wchr_index;
 
     uint32_t mod_status;
     size_t command_count;
     struct wtype_command *commands;
+    struct wtype_arena arena;
+
+    // When >= 0 commands are written to this uinput device instead of the
+    // virtual keyboard and key codes are evdev codes
+    int uinput_fd;
+    int error;
+};
+
+static const struct { xkb_keysym_t xkb; unsigned int code; } uinput_keys[] = {
+    {XKB_KEY_Escape, KEY_ESC},
+    {XKB_KEY_Return, KEY_ENTER},
+    {XKB_KEY_Tab, KEY_TAB},
+    {XKB_KEY_BackSpace, KEY_BACKSPACE},
+    {XKB_KEY_space, KEY_SPACE},
+    {XKB_KEY_XF86WakeUp, KEY_WAKEUP},
+};
+
+static const struct { enum wtype_mod mod; unsigned int code; } uinput_mods[] = {
+    {WTYPE_MOD_SHIFT, KEY_LEFTSHIFT},
+    {WTYPE_MOD_CAPSLOCK, KEY_CAPSLOCK},
+    {WTYPE_MOD_CTRL, KEY_LEFTCTRL},
+    {WTYPE_MOD_ALT, KEY_LEFTALT},
+    {WTYPE_MOD_LOGO, KEY_LEFTMETA},
+    {WTYPE_MOD_ALTGR, KEY_RIGHTALT},
 };
 
 static const struct { const char *name; enum wtype_mod mod; } mod_names[] = {
@@ -76,7 +121,7 @@ static const struct { const char *name; enum wtype_mod mod; } mod_names[] = {
 };
 
 extern const struct wl_registry_listener registry_listener;
-void upload_keymap(struct wtype *wtype);
+int upload_keymap(struct wtype *wtype);
 void handle_wl_event(void *data, struct wl_registry *registry, uint32_t name, const char *interface, uint32_t version);
 void handle_wl_event_remove(void *data, struct wl_registry *registry, uint32_t name);
 enum wtype_mod name_to_mod(const char *name);
@@ -89,6 +134,14 @@ void type_keycode(struct wtype *wtype, unsigned int key_code);
 void run_text(struct wtype *wtype, struct wtype_command *cmd);
 void run_commands(struct wtype *wtype);
 void print_keysym_name(xkb_keysym_t keysym, FILE *f);
-void upload_keymap(struct wtype *wtype);
+int uinput_open(struct wtype *wtype, const char *name);
+void uinput_close(struct wtype *wtype);
+int wtype_arena_init(struct wtype_arena *arena, size_t size);
+void *wtype_arena_alloc(struct wtype_arena *arena, size_t size);
+void wtype_arena_reset(struct wtype_arena *arena);
+void wtype_arena_free(struct wtype_arena *arena);
+struct wtype_command *wtype_alloc_commands(struct wtype *wtype, size_t count);
+unsigned int *wtype_alloc_key_codes(struct wtype *wtype, size_t count);
+void wtype_free_keymap(struct wtype *wtype);
 
 #endif // VIRTKEY_H
@@ -0,0 +1,518 @@
+// SPDX-License-Identifier: MIT
+// Copyright (C) 2026 Bardia Moshiri <bardia@furilabs.com>
+
+#include <stdio.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include "wlr-output-power-management-unstable-v1-client-protocol.h"
+#include "wake-action.h"
+#include "trace.h"
+
+#ifdef G_LOG_DOMAIN
+#undef G_LOG_DOMAIN
+#endif
+#define G_LOG_DOMAIN "GestureSensors"
+
+#define WAKE_MAX_OUTPUTS 4
+#define WAKE_MAX_FAILURES 3
+#define WAKE_ARENA_SIZE 256
+#define WAKE_CONFIRM_TIMEOUT_MS 300
+
+static const gchar *backend_names[WAKE_BACKEND_COUNT] = {
+    [WAKE_BACKEND_OUTPUT_POWER] = "output-power",
+    [WAKE_BACKEND_UINPUT] = "uinput",
+    [WAKE_BACKEND_VIRTUAL_KEYBOARD] = "virtual-keyboard",
+    [WAKE_BACKEND_LOGIND] = "logind",
+};
+
+// uinput is a plain write() the compositor may ignore and logind only
+// accepts the hint, neither says whether the panel lit up. output-power waits
+// for the compositor's mode event itself, the virtual keyboard is left
+// unconfirmed as it always was.
+static const gboolean backend_needs_confirm[WAKE_BACKEND_COUNT] = {
+    [WAKE_BACKEND_UINPUT] = TRUE,
+    [WAKE_BACKEND_LOGIND] = TRUE,
+};
+
+struct output_power_entry {
+    struct wl_output *output;
+    struct zwlr_output_power_v1 *power;
+    uint32_t mode;
+    gboolean failed;
+};
+
+struct output_power_state {
+    struct zwlr_output_power_manager_v1 *manager;
+    struct output_power_entry outputs[WAKE_MAX_OUTPUTS];
+    guint n_outputs;
+};
+
+// The keymap and command arena are built once in wake_action_init(), a wake
+// only resets the arena so nothing on this path goes through malloc
+static gboolean
+send_wake_key(WakeAction *wa)
+{
+    struct wtype *wtype = &wa->keyboard;
+
+    if (wa->escape_code == WTYPE_KEY_CODE_NONE)
+        return FALSE;
+
+    wtype_arena_reset(&wtype->arena);
+    wtype->commands = wtype_alloc_commands(wtype, 1);
+    wtype->command_count = 1;
+
+    struct wtype_command *cmd = &wtype->commands[0];
+    cmd->type = WTYPE_COMMAND_TEXT;
+    cmd->key_codes = wtype_alloc_key_codes(wtype, 1);
+    cmd->key_codes_len = 1;
+    cmd->key_codes[0] = wa->escape_code;
+    cmd->delay_ms = 0;
+
+    gboolean sent = FALSE;
+
+    wtype->display = wl_display_connect(NULL);
+    if (wtype->display == NULL) {
+        g_printerr("Wayland connection failed\n");
+        return FALSE;
+    }
+    wtype->registry = wl_display_get_registry(wtype->display);
+    wl_registry_add_listener(wtype->registry, &registry_listener, wtype);
+    wl_display_dispatch(wtype->display);
+    wl_display_roundtrip(wtype->display);
+
+    if (wtype->manager == NULL) {
+        g_printerr("Compositor does not support the virtual keyboard protocol\n");
+        goto out;
+    }
+    if (wtype->seat == NULL) {
+        g_printerr("No seat found\n");
+        goto out;
+    }
+
+    wtype->keyboard = zwp_virtual_keyboard_manager_v1_create_virtual_keyboard(
+        wtype->manager, wtype->seat
+    );
+
+    if (upload_keymap(wtype) < 0) {
+        g_printerr("Failed to upload the keymap\n");
+        goto out;
+    }
+    wtype->error = 0;
+    run_commands(wtype);
+    sent = (wtype->error == 0);
+
+out:
+    // Every proxy has to go before the disconnect, the display does not free
+    // them for us
+    if (wtype->keyboard)
+        zwp_virtual_keyboard_v1_destroy(wtype->keyboard);
+    if (wtype->manager)
+        zwp_virtual_keyboard_manager_v1_destroy(wtype->manager);
+    if (wtype->seat)
+        wl_seat_destroy(wtype->seat);
+    wl_registry_destroy(wtype->registry);
+    wl_display_disconnect(wtype->display);
+    wtype->keyboard = NULL;
+    wtype->manager = NULL;
+    wtype->seat = NULL;
+    wtype->registry = NULL;
+    wtype->display = NULL;
+    wtype->commands = NULL;
+    wtype->command_count = 0;
+
+    return sent;
+}
+
+static void
+output_power_handle_mode(void *data,
+                         struct zwlr_output_power_v1 *output_power,
+                         uint32_t mode)
+{
+    struct output_power_entry *entry = data;
+    entry->mode = mode;
+}
+
+static void
+output_power_handle_failed(void *data,
+                           struct zwlr_output_power_v1 *output_power)
+{
+    struct output_power_entry *entry = data;
+    entry->failed = TRUE;
+}
+
+static const struct zwlr_output_power_v1_listener output_power_listener = {
+    .mode = output_power_handle_mode,
+    .failed = output_power_handle_failed,
+};
+
+static void
+output_power_handle_global(void *data,
+                           struct wl_registry *registry,
+                           uint32_t name,
+                           const char *interface,
+                           uint32_t version)
+{
+    struct output_power_state *state = data;
+
+    if (!strcmp(interface, zwlr_output_power_manager_v1_interface.name)) {
+        state->manager = wl_registry_bind(registry, name, &zwlr_output_power_manager_v1_interface, 1);
+    } else if (!strcmp(interface, wl_output_interface.name) && state->n_outputs < WAKE_MAX_OUTPUTS) {
+        state->outputs[state->n_outputs++].output = wl_registry_bind(registry, name, &wl_output_interface, 1);
+    }
+}
+
+static void
+output_power_handle_global_remove(void *data,
+                                  struct wl_registry *registry,
+                                  uint32_t name)
+{
+}
+
+static const struct wl_registry_listener output_power_registry_listener = {
+    .global = output_power_handle_global,
+    .global_remove = output_power_handle_global_remove,
+};
+
+// wlr-output-power-management: ask the compositor to power the outputs on and
+// wait for it to confirm the new mode
+static gboolean
+wake_output_power(WakeAction *wa)
+{
+    struct output_power_state state = {0};
+    struct wl_display *display;
+    struct wl_registry *registry;
+    gboolean powered = FALSE;
+
+    display = wl_display_connect(NULL);
+    if (!display) {
+        g_debug("output-power: Wayland connection failed");
+        return FALSE;
+    }
+
+    registry = wl_display_get_registry(display);
+    wl_registry_add_listener(registry, &output_power_registry_listener, &state);
+    wl_display_roundtrip(display);
+
+    if (state.manager) {
+        for (guint i = 0; i < state.n_outputs; i++) {
+            struct output_power_entry *entry = &state.outputs[i];
+            entry->power = zwlr_output_power_manager_v1_get_output_power(state.manager, entry->output);
+            zwlr_output_power_v1_add_listener(entry->power, &output_power_listener, entry);
+            zwlr_output_power_v1_set_mode(entry->power, ZWLR_OUTPUT_POWER_V1_MODE_ON);
+        }
+
+        // Each output reports its current mode right away and again once
+        // set_mode has been applied, the last event wins
+        wl_display_roundtrip(display);
+
+        for (guint i = 0; i < state.n_outputs; i++) {
+            if (!state.outputs[i].failed && state.outputs[i].mode == ZWLR_OUTPUT_POWER_V1_MODE_ON)
+                powered = TRUE;
+        }
+    } else {
+        g_debug("output-power: compositor does not support wlr-output-power-management");
+    }
+
+    for (guint i = 0; i < state.n_outputs; i++) {
+        if (state.outputs[i].power)
+            zwlr_output_power_v1_destroy(state.outputs[i].power);
+        wl_output_destroy(state.outputs[i].output);
+    }
+    if (state.manager)
+        zwlr_output_power_manager_v1_destroy(state.manager);
+    wl_registry_destroy(registry);
+    wl_display_disconnect(display);
+
+    return powered;
+}
+
+// uinput: the device is created once up front, a compositor only picks up
+// keys from an input device it has already opened
+static gboolean
+wake_uinput(WakeAction *wa)
+{
+    if (wa->uinput.uinput_fd < 0)
+        return FALSE;
+
+    unsigned int key_code = get_key_code_by_xkb(&wa->uinput, XKB_KEY_Escape);
+    struct wtype_command cmd = {
+        .type = WTYPE_COMMAND_TEXT,
+        .key_codes = &key_code,
+        .key_codes_len = 1,
+        .delay_ms = 0,
+    };
+
+    wa->uinput.commands = &cmd;
+    wa->uinput.command_count = 1;
+    wa->uinput.error = 0;
+    run_commands(&wa->uinput);
+    wa->uinput.commands = NULL;
+    wa->uinput.command_count = 0;
+
+    if (wa->uinput.error) {
+        g_debug("uinput: write failed: %s", g_strerror(wa->uinput.error));
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+static gboolean
+wake_virtual_keyboard(WakeAction *wa)
+{
+    return send_wake_key(wa);
+}
+
+// logind only confirms the hint was accepted, not that the panel lit up, so
+// auto mode never picks it on its own
+static gboolean
+wake_logind(WakeAction *wa)
+{
+    GVariant *result;
+    GError *error = NULL;
+
+    if (!wa->session_path)
+        return FALSE;
+
+    result = g_dbus_connection_call_sync(wa->dbus_connection,
+                                         "org.freedesktop.login1",
+                                         wa->session_path,
+                                         "org.freedesktop.login1.Session",
+                                         "SetIdleHint",
+                                         g_variant_new("(b)", FALSE),
+                                         NULL,
+                                         G_DBUS_CALL_FLAGS_NONE,
+                                         -1,
+                                         NULL,
+                                         &error);
+
+    if (error) {
+        g_debug("logind: SetIdleHint failed: %s", error->message);
+        g_error_free(error);
+        return FALSE;
+    }
+
+    g_variant_unref(result);
+
+    return TRUE;
+}
+
+static gboolean (*const backend_funcs[WAKE_BACKEND_COUNT])(WakeAction *) = {
+    [WAKE_BACKEND_OUTPUT_POWER] = wake_output_power,
+    [WAKE_BACKEND_UINPUT] = wake_uinput,
+    [WAKE_BACKEND_VIRTUAL_KEYBOARD] = wake_virtual_keyboard,
+    [WAKE_BACKEND_LOGIND] = wake_logind,
+};
+
+void
+wake_action_init(WakeAction *wa, GDBusConnection *dbus_connection)
+{
+    memset(wa, 0, sizeof(*wa));
+    wa->dbus_connection = dbus_connection;
+    wa->preferred = WAKE_BACKEND_VIRTUAL_KEYBOARD;
+    wa->last_backend = -1;
+    wa->confirm_backend = -1;
+
+    wa->keyboard.uinput_fd = -1;
+    if (wtype_arena_init(&wa->keyboard.arena, WAKE_ARENA_SIZE) < 0)
+        g_error("Failed to allocate the wake command arena");
+    wa->escape_code = get_key_code_by_xkb(&wa->keyboard, XKB_KEY_Escape);
+    if (wa->escape_code == WTYPE_KEY_CODE_NONE)
+        g_warning("No keymap entry for Escape, virtual keyboard wakes will fail: %s",
+                  g_strerror(wa->keyboard.error));
+
+    wa->uinput.uinput_fd = -1;
+    if (uinput_open(&wa->uinput, WAKE_ACTION_UINPUT_NAME) < 0)
+        g_debug("uinput wake backend unavailable: %s", g_strerror(errno));
+}
+
+void
+wake_action_clear(WakeAction *wa)
+{
+    // The timeout callback lives in the module, it cannot outlive it
+    if (wa->confirm_timeout_id > 0)
+        g_source_remove(wa->confirm_timeout_id);
+    wa->confirm_timeout_id = 0;
+
+    uinput_close(&wa->uinput);
+    wtype_free_keymap(&wa->keyboard);
+    wtype_arena_free(&wa->keyboard.arena);
+
+    g_free(wa->session_path);
+    wa->session_path = NULL;
+}
+
+void
+wake_action_set_session(WakeAction *wa, const gchar *session_id)
+{
+    g_free(wa->session_path);
+    wa->session_path = g_strdup_printf("/org/freedesktop/login1/session/%s", session_id);
+}
+
+gboolean
+wake_action_set_backend(WakeAction *wa, const gchar *name)
+{
+    if (g_strcmp0(name, "auto") == 0) {
+        wa->preferred = WAKE_BACKEND_AUTO;
+        return TRUE;
+    }
+
+    for (gint i = 0; i < WAKE_BACKEND_COUNT; i++) {
+        if (g_strcmp0(name, backend_names[i]) == 0) {
+            wa->preferred = i;
+            return TRUE;
+        }
+    }
+
+    g_warning("Unknown wake backend '%s', using auto", name);
+    wa->preferred = WAKE_BACKEND_AUTO;
+    return FALSE;
+}
+
+const gchar *
+wake_action_backend_name(WakeBackendId id)
+{
+    return id < WAKE_BACKEND_COUNT ? backend_names[id] : "none";
+}
+
+// Unmeasured backends are tried first in priority order so each gets a
+// latency figure, after that the fastest one that keeps turning the screen
+// on wins. Backends that need confirming sit out when it is not available.
+static gint
+pick_auto_backend(WakeAction *wa)
+{
+    gint best = -1;
+
+    for (gint i = 0; i < WAKE_BACKEND_COUNT; i++) {
+        if (wa->tried[i] || i == WAKE_BACKEND_LOGIND || wa->failures[i] >= WAKE_MAX_FAILURES)
+            continue;
+        if (backend_needs_confirm[i] && !wa->can_confirm)
+            continue;
+        if (wa->latency_us[i] == 0)
+            return i;
+        if (best == -1 || wa->latency_us[i] < wa->latency_us[best])
+            best = i;
+    }
+
+    return best;
+}
+
+static gint
+next_backend(WakeAction *wa)
+{
+    gint id = -1;
+
+    if (wa->preferred == WAKE_BACKEND_AUTO)
+        id = pick_auto_backend(wa);
+    else if (!wa->tried[wa->preferred])
+        id = wa->preferred;
+
+    // The virtual keyboard is what the daemon always used, keep it as the
+    // last resort regardless of its failure count
+    if (id == -1 && !wa->tried[WAKE_BACKEND_VIRTUAL_KEYBOARD])
+        id = WAKE_BACKEND_VIRTUAL_KEYBOARD;
+
+    return id;
+}
+
+// Latency runs until the screen is confirmed on where it can be, which is
+// what auto ranks
+static void
+score_backend(WakeAction *wa, gint id, gint64 elapsed, gboolean ok)
+{
+    trace_log(TRACE_RECORD_WAKE_ACTION, 0, id, elapsed, ok);
+
+    if (!ok) {
+        g_debug("Wake backend %s did not turn the screen on", backend_names[id]);
+        wa->failures[id]++;
+        return;
+    }
+
+    wa->failures[id] = 0;
+    wa->latency_us[id] = wa->latency_us[id] ? (wa->latency_us[id] * 3 + elapsed) / 4 : MAX(elapsed, 1);
+}
+
+static gboolean run_backends(WakeAction *wa);
+
+static gboolean
+on_confirm_timeout(gpointer user_data)
+{
+    WakeAction *wa = user_data;
+
+    wa->confirm_timeout_id = 0;
+    score_backend(wa, wa->confirm_backend, g_get_monotonic_time() - wa->confirm_started, FALSE);
+    wa->confirm_backend = -1;
+
+    if (!run_backends(wa))
+        g_warning("All wake backends failed");
+
+    return G_SOURCE_REMOVE;
+}
+
+// Returns once the request is out. A backend that needs confirming is only
+// scored when wake_action_confirm() or the timeout comes in, so the main
+// loop keeps running in between.
+static gboolean
+start_backend(WakeAction *wa, gint id)
+{
+    gint64 started = g_get_monotonic_time();
+
+    wa->tried[id] = TRUE;
+    if (!backend_funcs[id](wa)) {
+        score_backend(wa, id, g_get_monotonic_time() - started, FALSE);
+        return FALSE;
+    }
+
+    wa->last_backend = id;
+    if (!backend_needs_confirm[id] || !wa->can_confirm) {
+        score_backend(wa, id, g_get_monotonic_time() - started, TRUE);
+        return TRUE;
+    }
+
+    wa->confirm_backend = id;
+    wa->confirm_started = started;
+    wa->confirm_timeout_id = g_timeout_add(WAKE_CONFIRM_TIMEOUT_MS, on_confirm_timeout, wa);
+
+    return TRUE;
+}
+
+static gboolean
+run_backends(WakeAction *wa)
+{
+    gint id;
+
+    while ((id = next_backend(wa)) != -1) {
+        if (start_backend(wa, id))
+            return TRUE;
+    }
+
+    return FALSE;
+}
+
+gboolean
+wake_action_run(WakeAction *wa, gboolean can_confirm)
+{
+    // A wake still waiting on the previous one supersedes it unscored
+    if (wa->confirm_timeout_id > 0)
+        g_source_remove(wa->confirm_timeout_id);
+    wa->confirm_timeout_id = 0;
+    wa->confirm_backend = -1;
+
+    memset(wa->tried, 0, sizeof(wa->tried));
+    wa->can_confirm = can_confirm;
+
+    return run_backends(wa);
+}
+
+void
+wake_action_confirm(WakeAction *wa)
+{
+    if (wa->confirm_timeout_id == 0)
+        return;
+
+    g_source_remove(wa->confirm_timeout_id);
+    wa->confirm_timeout_id = 0;
+    score_backend(wa, wa->confirm_backend, g_get_monotonic_time() - wa->confirm_started, TRUE);
+    wa->confirm_backend = -1;
+}
@@ -0,0 +1,58 @@
+// SPDX-License-Identifier: MIT
+// Copyright (C) 2026 Bardia Moshiri <bardia@furilabs.com>
+
+#ifndef WAKE_ACTION_H
+#define WAKE_ACTION_H
+
+#include <glib.h>
+#include <gio/gio.h>
+#include "virtkey.h"
+
+// Listed in the order auto mode tries backends that have not been measured yet
+typedef enum {
+    WAKE_BACKEND_OUTPUT_POWER = 0,
+    WAKE_BACKEND_UINPUT,
+    WAKE_BACKEND_VIRTUAL_KEYBOARD,
+    WAKE_BACKEND_LOGIND,
+    WAKE_BACKEND_COUNT,
+} WakeBackendId;
+
+#define WAKE_BACKEND_AUTO (-1)
+
+// Name of the uinput device wakes are injected through, input sources skip it
+#define WAKE_ACTION_UINPUT_NAME "gesture-sensors wake"
+
+typedef struct {
+    GDBusConnection *dbus_connection;
+    gchar *session_path;
+    gint preferred;
+    struct wtype keyboard;
+    unsigned int escape_code;
+    struct wtype uinput;
+
+    // Smoothed wall time of successful wakes per backend, 0 until measured
+    gint64 latency_us[WAKE_BACKEND_COUNT];
+    guint failures[WAKE_BACKEND_COUNT];
+    gint last_backend;
+
+    // State of the wake in flight, a backend waiting on the screen to
+    // report on has confirm_timeout_id set
+    gboolean tried[WAKE_BACKEND_COUNT];
+    gboolean can_confirm;
+    gint confirm_backend;
+    gint64 confirm_started;
+    guint confirm_timeout_id;
+} WakeAction;
+
+void wake_action_init(WakeAction *wa, GDBusConnection *dbus_connection);
+void wake_action_clear(WakeAction *wa);
+void wake_action_set_session(WakeAction *wa, const gchar *session_id);
+gboolean wake_action_set_backend(WakeAction *wa, const gchar *name);
+// can_confirm promises a wake_action_confirm() call once the outputs report
+// on. Without it backends that cannot tell whether the screen lit up are
+// trusted when chosen explicitly and skipped by auto.
+gboolean wake_action_run(WakeAction *wa, gboolean can_confirm);
+void wake_action_confirm(WakeAction *wa);
+const gchar *wake_action_backend_name(WakeBackendId id);
+
+#endif // WAKE_ACTION_H
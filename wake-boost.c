@@ -0,0 +1,152 @@
+// SPDX-License-Identifier: MIT
+// Copyright (C) 2026 Bardia Moshiri <bardia@furilabs.com>
+
+#define _GNU_SOURCE
+#include <errno.h>
+#include <sched.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include "wake-boost.h"
+
+#ifndef SCHED_FLAG_UTIL_CLAMP_MIN
+#define SCHED_FLAG_UTIL_CLAMP_MIN 0x20
+#endif
+
+static int
+boost_getattr(struct wake_boost_attr *attr)
+{
+    memset(attr, 0, sizeof(*attr));
+    return syscall(SYS_sched_getattr, 0, attr, sizeof(*attr), 0);
+}
+
+static int
+boost_setattr(struct wake_boost_attr *attr)
+{
+    attr->size = sizeof(*attr);
+    return syscall(SYS_sched_setattr, 0, attr, 0);
+}
+
+// Missing CAP_SYS_NICE or uclamp support is expected on some setups, say so
+// once instead of on every wake
+static void
+boost_warn(WakeBoost *boost, const gchar *what)
+{
+    if (boost->warned)
+        return;
+
+    g_warning("Wake boost could not %s: %s", what, g_strerror(errno));
+    boost->warned = TRUE;
+}
+
+void
+wake_boost_init(WakeBoost *boost)
+{
+    memset(boost, 0, sizeof(*boost));
+    boost->cpu = -1;
+}
+
+void
+wake_boost_clear(WakeBoost *boost)
+{
+    wake_boost_leave(boost);
+    g_free(boost->saved_affinity);
+    wake_boost_init(boost);
+}
+
+gboolean
+wake_boost_set_mode(WakeBoost *boost, const gchar *name)
+{
+    if (g_strcmp0(name, "none") == 0)
+        boost->mode = WAKE_BOOST_NONE;
+    else if (g_strcmp0(name, "nice") == 0)
+        boost->mode = WAKE_BOOST_NICE;
+    else if (g_strcmp0(name, "fifo") == 0)
+        boost->mode = WAKE_BOOST_FIFO;
+    else
+        return FALSE;
+
+    boost->warned = FALSE;
+    return TRUE;
+}
+
+// Raises the calling thread for the wake path. Scheduling class, nice and
+// uclamp go in one sched_setattr() so entering and leaving cost a syscall
+// each, plus one for affinity when pinning. Returns TRUE if anything was
+// actually raised.
+gboolean
+wake_boost_enter(WakeBoost *boost)
+{
+    struct wake_boost_attr attr;
+
+    if (boost->active || (boost->mode == WAKE_BOOST_NONE && boost->uclamp_min == 0 && boost->cpu < 0))
+        return FALSE;
+
+    if (boost_getattr(&boost->saved) < 0) {
+        boost_warn(boost, "read the scheduling policy");
+        return FALSE;
+    }
+
+    attr = boost->saved;
+    attr.sched_flags = 0;
+
+    switch (boost->mode) {
+    case WAKE_BOOST_FIFO:
+        attr.sched_policy = SCHED_FIFO;
+        attr.sched_priority = boost->fifo_priority;
+        attr.sched_nice = 0;
+        break;
+    case WAKE_BOOST_NICE:
+        attr.sched_nice = boost->nice;
+        break;
+    case WAKE_BOOST_NONE:
+        break;
+    }
+
+    if (boost->uclamp_min > 0) {
+        attr.sched_flags |= SCHED_FLAG_UTIL_CLAMP_MIN;
+        attr.sched_util_min = boost->uclamp_min;
+    }
+
+    gboolean raised = (boost_setattr(&attr) == 0);
+    if (!raised)
+        boost_warn(boost, "raise the wake thread");
+
+    boost->affinity_saved = FALSE;
+    if (boost->cpu >= 0) {
+        cpu_set_t set;
+
+        if (!boost->saved_affinity)
+            boost->saved_affinity = g_new0(cpu_set_t, 1);
+
+        if (sched_getaffinity(0, sizeof(cpu_set_t), boost->saved_affinity) == 0) {
+            CPU_ZERO(&set);
+            CPU_SET(boost->cpu, &set);
+            if (sched_setaffinity(0, sizeof(set), &set) == 0)
+                boost->affinity_saved = TRUE;
+            else
+                boost_warn(boost, "pin the wake thread");
+        }
+    }
+
+    // Leaving restores whatever was saved even when only part of it applied
+    boost->active = TRUE;
+    return raised || boost->affinity_saved;
+}
+
+void
+wake_boost_leave(WakeBoost *boost)
+{
+    if (!boost->active)
+        return;
+
+    if (boost->affinity_saved)
+        sched_setaffinity(0, sizeof(cpu_set_t), boost->saved_affinity);
+
+    boost->saved.sched_flags = boost->uclamp_min > 0 ? SCHED_FLAG_UTIL_CLAMP_MIN : 0;
+    if (boost_setattr(&boost->saved) < 0)
+        g_warning("Failed to drop wake boost: %s", g_strerror(errno));
+
+    boost->affinity_saved = FALSE;
+    boost->active = FALSE;
+}
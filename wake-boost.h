@@ -0,0 +1,50 @@
+// SPDX-License-Identifier: MIT
+// Copyright (C) 2026 Bardia Moshiri <bardia@furilabs.com>
+
+#ifndef WAKE_BOOST_H
+#define WAKE_BOOST_H
+
+#include <stdint.h>
+#include <glib.h>
+
+typedef enum {
+    WAKE_BOOST_NONE = 0,
+    WAKE_BOOST_NICE,
+    WAKE_BOOST_FIFO,
+} WakeBoostMode;
+
+// Mirrors the kernel's struct sched_attr up to the uclamp fields
+struct wake_boost_attr {
+    uint32_t size;
+    uint32_t sched_policy;
+    uint64_t sched_flags;
+    int32_t sched_nice;
+    uint32_t sched_priority;
+    uint64_t sched_runtime;
+    uint64_t sched_deadline;
+    uint64_t sched_period;
+    uint32_t sched_util_min;
+    uint32_t sched_util_max;
+};
+
+typedef struct {
+    WakeBoostMode mode;
+    gint fifo_priority;
+    gint nice;
+    gint uclamp_min; // 0 leaves utilization clamping alone
+    gint cpu;        // -1 leaves affinity alone
+
+    gboolean active;
+    struct wake_boost_attr saved;
+    gboolean affinity_saved;
+    gpointer saved_affinity; // cpu_set_t, allocated on first pin
+    gboolean warned;
+} WakeBoost;
+
+void wake_boost_init(WakeBoost *boost);
+void wake_boost_clear(WakeBoost *boost);
+gboolean wake_boost_set_mode(WakeBoost *boost, const gchar *name);
+gboolean wake_boost_enter(WakeBoost *boost);
+void wake_boost_leave(WakeBoost *boost);
+
+#endif // WAKE_BOOST_H
@@ -0,0 +1,300 @@
+// SPDX-License-Identifier: MIT
+// Copyright (C) 2026 Bardia Moshiri <bardia@furilabs.com>
+
+#include <string.h>
+#include "wake-machine.h"
+
+static int
+wanted(const struct wake_machine *wm)
+{
+    return wm->wake_enabled || wm->tilt_enabled || wm->listening;
+}
+
+// Prepared sessions have been running since before the blank, whatever they
+// latched in the meantime is cleared instead of cycling them
+static unsigned int
+arm_now(struct wake_machine *wm)
+{
+    wm->state = WAKE_MACHINE_ARMED;
+
+    if (wm->prepared) {
+        wm->prepared = 0;
+        return WAKE_MACHINE_RESET_WAKE | WAKE_MACHINE_RESET_TILT | WAKE_MACHINE_START_POLLING;
+    }
+
+    wm->acquisitions++;
+    return WAKE_MACHINE_RELEASE | WAKE_MACHINE_ACQUIRE | WAKE_MACHINE_START_POLLING;
+}
+
+// IdleHint can flap several times a second around notifications and lock
+// screen transitions. Arming waits for idle to hold for the debounce window
+// so a burst collapses into one sensor power cycle, disarming is immediate.
+static unsigned int
+begin_arm(struct wake_machine *wm, uint64_t now)
+{
+    if (wm->state != WAKE_MACHINE_DISARMED || !wanted(wm))
+        return 0;
+
+    if (wm->config.debounce_us == 0)
+        return arm_now(wm);
+
+    wm->state = WAKE_MACHINE_ARM_PENDING;
+    wm->arm_deadline = now + wm->config.debounce_us;
+    return WAKE_MACHINE_SCHEDULE_ARM;
+}
+
+// Polling stops but sessions stay held, the next arm cycles them anyway
+static unsigned int
+stop(struct wake_machine *wm)
+{
+    unsigned int actions = 0;
+
+    if (wm->state == WAKE_MACHINE_ARM_PENDING)
+        actions = WAKE_MACHINE_CANCEL_ARM;
+    else if (wm->state == WAKE_MACHINE_ARMED)
+        actions = WAKE_MACHINE_STOP_POLLING;
+
+    wm->state = WAKE_MACHINE_DISARMED;
+    return actions;
+}
+
+// Nothing will arm until the next idle, so sessions an arm or prepare left
+// held are given back as well
+static unsigned int
+stop_and_release(struct wake_machine *wm)
+{
+    unsigned int actions = stop(wm);
+
+    if ((actions & WAKE_MACHINE_STOP_POLLING) || wm->prepared)
+        actions |= WAKE_MACHINE_RELEASE;
+    wm->prepared = 0;
+
+    return actions;
+}
+
+// Wake and tilt often both fire for one motion, possibly on different poll
+// iterations. Events are folded by their timestamps so the wake action runs
+// at most once per dedup window of each clock.
+static int
+is_duplicate(struct wake_machine *wm, enum wake_machine_clock clock, uint64_t event)
+{
+    uint64_t last = wm->last_wake_event[clock];
+
+    if (last && event >= last && event - last < wm->config.dedup_us)
+        return 1;
+
+    wm->vetoed_wake_event[clock] = last;
+    wm->last_wake_event[clock] = event;
+    return 0;
+}
+
+void
+wake_machine_init(struct wake_machine *wm, const struct wake_machine_config *config)
+{
+    memset(wm, 0, sizeof(*wm));
+    wm->config = *config;
+}
+
+unsigned int
+wake_machine_idle(struct wake_machine *wm, int idle, uint64_t now)
+{
+    wm->idle = idle;
+
+    if (idle)
+        return begin_arm(wm, now);
+
+    return stop_and_release(wm);
+}
+
+unsigned int
+wake_machine_arm_timer(struct wake_machine *wm, uint64_t now)
+{
+    if (wm->state != WAKE_MACHINE_ARM_PENDING)
+        return 0;
+
+    // Timers are coarser than the clock, an early tick just waits again
+    if (now < wm->arm_deadline)
+        return WAKE_MACHINE_SCHEDULE_ARM;
+
+    return arm_now(wm);
+}
+
+// The outputs going dark is final, unlike IdleHint there is no flapping to
+// wait out, so the debounce is skipped
+unsigned int
+wake_machine_blank(struct wake_machine *wm)
+{
+    unsigned int actions = 0;
+
+    wm->idle = 1;
+    wm->screen_off = 1;
+
+    if (!wanted(wm) || wm->state == WAKE_MACHINE_ARMED)
+        return 0;
+
+    if (wm->state == WAKE_MACHINE_ARM_PENDING)
+        actions = WAKE_MACHINE_CANCEL_ARM;
+
+    return actions | arm_now(wm);
+}
+
+// A blank is likely soon, the lock screen for one. Sessions are requested
+// now so the arm itself only has to start polling.
+unsigned int
+wake_machine_prepare(struct wake_machine *wm)
+{
+    if (wm->state != WAKE_MACHINE_DISARMED || wm->prepared || !wanted(wm))
+        return 0;
+
+    wm->prepared = 1;
+    wm->acquisitions++;
+    return WAKE_MACHINE_RELEASE | WAKE_MACHINE_ACQUIRE;
+}
+
+// Nothing could be requested, the caller drops polling and standby
+void
+wake_machine_acquire_failed(struct wake_machine *wm)
+{
+    wm->state = WAKE_MACHINE_DISARMED;
+    wm->prepared = 0;
+}
+
+// sensorfw went away, prepared sessions went with it
+void
+wake_machine_sessions_lost(struct wake_machine *wm)
+{
+    wm->prepared = 0;
+}
+
+unsigned int
+wake_machine_settings(struct wake_machine *wm, int wake_enabled, int tilt_enabled,
+                      int listening, uint64_t now)
+{
+    wm->wake_enabled = wake_enabled;
+    wm->tilt_enabled = tilt_enabled;
+    wm->listening = listening;
+
+    if (!wanted(wm))
+        return stop_and_release(wm);
+
+    return wm->idle ? begin_arm(wm, now) : 0;
+}
+
+unsigned int
+wake_machine_screen(struct wake_machine *wm, int on)
+{
+    wm->screen_off = !on;
+
+    if (!on || wm->state != WAKE_MACHINE_ARMED)
+        return 0;
+
+    return stop(wm);
+}
+
+unsigned int
+wake_machine_reading(struct wake_machine *wm, const struct wake_machine_reading *reading)
+{
+    unsigned int actions = 0;
+
+    if (wm->state != WAKE_MACHINE_ARMED)
+        return 0;
+
+    // A latch whose timestamp was already handled is the same event read
+    // again because its reset has not landed yet
+    int wake_latched = reading->wake == 1 && reading->wake_timestamp != wm->wake_latched_at;
+    int tilt_latched = reading->tilt == 1 && reading->tilt_timestamp != wm->tilt_latched_at;
+    if (!wake_latched && !tilt_latched)
+        return 0;
+
+    if (wake_latched) {
+        wm->wake_latched_at = reading->wake_timestamp;
+        actions |= WAKE_MACHINE_EMIT_WAKE | WAKE_MACHINE_RESET_WAKE;
+    }
+    if (tilt_latched) {
+        wm->tilt_latched_at = reading->tilt_timestamp;
+        actions |= WAKE_MACHINE_EMIT_TILT | WAKE_MACHINE_RESET_TILT;
+    }
+
+    // Only listeners asked for this one
+    if (!(wake_latched && wm->wake_enabled) && !(tilt_latched && wm->tilt_enabled))
+        return actions;
+
+    uint64_t event = wake_latched ? reading->wake_timestamp : 0;
+    if (tilt_latched && reading->tilt_timestamp > event)
+        event = reading->tilt_timestamp;
+    if (is_duplicate(wm, WAKE_MACHINE_CLOCK_SENSOR, event))
+        return actions;
+
+    wm->state = WAKE_MACHINE_DISARMED;
+    wm->acquisitions++;
+    return actions | WAKE_MACHINE_STOP_POLLING | WAKE_MACHINE_RELEASE |
+           WAKE_MACHINE_ACQUIRE | WAKE_MACHINE_WAKE;
+}
+
+// The proximity gate vetoed a wake from wake_machine_reading() or
+// wake_machine_input(): the screen stays off and a reading's latch is cleared
+// with polling carrying on. A vetoed wake did not happen, so it must not
+// swallow a real one inside its dedup window.
+unsigned int
+wake_machine_blocked(struct wake_machine *wm, unsigned int actions)
+{
+    if (!(actions & WAKE_MACHINE_WAKE))
+        return actions;
+
+    // Input wakes leave the sensors alone, there is no arm to restore
+    if (!(actions & WAKE_MACHINE_ACQUIRE)) {
+        wm->last_wake_event[WAKE_MACHINE_CLOCK_INPUT] = wm->vetoed_wake_event[WAKE_MACHINE_CLOCK_INPUT];
+    } else {
+        wm->last_wake_event[WAKE_MACHINE_CLOCK_SENSOR] = wm->vetoed_wake_event[WAKE_MACHINE_CLOCK_SENSOR];
+        wm->state = WAKE_MACHINE_ARMED;
+        wm->acquisitions--;
+    }
+
+    return actions & ~(WAKE_MACHINE_STOP_POLLING | WAKE_MACHINE_RELEASE |
+                       WAKE_MACHINE_ACQUIRE | WAKE_MACHINE_WAKE);
+}
+
+// Input wake keys are latched by the panel and leave the sensors alone. Some
+// panels report them while the screen is in use too, those are ignored.
+unsigned int
+wake_machine_input(struct wake_machine *wm, uint64_t timestamp)
+{
+    if (!wm->idle && !wm->screen_off)
+        return 0;
+
+    return is_duplicate(wm, WAKE_MACHINE_CLOCK_INPUT, timestamp) ? 0 : WAKE_MACHINE_WAKE;
+}
+
+// Polling freezes with the AP, so sensors are armed ahead of suspend and left
+// running, and polling picks the latch up again on resume
+unsigned int
+wake_machine_sleep(struct wake_machine *wm, int sleeping)
+{
+    unsigned int actions = 0;
+
+    if (!sleeping)
+        return wm->state == WAKE_MACHINE_ARMED ? WAKE_MACHINE_START_POLLING : 0;
+
+    if (!wanted(wm))
+        return 0;
+
+    if (wm->state == WAKE_MACHINE_ARM_PENDING)
+        actions |= WAKE_MACHINE_CANCEL_ARM;
+
+    if (wm->state != WAKE_MACHINE_ARMED)
+        actions |= arm_now(wm) & ~WAKE_MACHINE_START_POLLING;
+
+    return actions | WAKE_MACHINE_STOP_POLLING | WAKE_MACHINE_STANDBY;
+}
+
+int
+wake_machine_polls_wake(const struct wake_machine *wm)
+{
+    return wm->wake_enabled || wm->listening;
+}
+
+int
+wake_machine_polls_tilt(const struct wake_machine *wm)
+{
+    return wm->tilt_enabled || wm->listening;
+}
@@ -0,0 +1,97 @@
+// SPDX-License-Identifier: MIT
+// Copyright (C) 2026 Bardia Moshiri <bardia@furilabs.com>
+
+#ifndef WAKE_MACHINE_H
+#define WAKE_MACHINE_H
+
+#include <stdint.h>
+
+// Arming and wake decisions without any I/O. Every event takes the current
+// time from the caller and returns the actions to carry out, so the daemon
+// runs it on the monotonic clock and --replay on the trace's clock.
+
+enum wake_machine_state {
+    WAKE_MACHINE_DISARMED = 0,
+    WAKE_MACHINE_ARM_PENDING = 1,
+    WAKE_MACHINE_ARMED = 2,
+};
+
+// Carried out in the order listed, except WAKE, which goes first so the
+// screen does not wait on the session cycling
+enum wake_machine_action {
+    WAKE_MACHINE_EMIT_WAKE = 1 << 0,     // broadcast the wake latch
+    WAKE_MACHINE_EMIT_TILT = 1 << 1,     // broadcast the tilt latch
+    WAKE_MACHINE_CANCEL_ARM = 1 << 2,    // drop the debounce timer
+    WAKE_MACHINE_STOP_POLLING = 1 << 3,
+    WAKE_MACHINE_RESET_WAKE = 1 << 4,    // clear the wake sensor latch
+    WAKE_MACHINE_RESET_TILT = 1 << 5,    // clear the tilt source latch
+    WAKE_MACHINE_RELEASE = 1 << 6,       // release sensor sessions
+    WAKE_MACHINE_ACQUIRE = 1 << 7,       // request sensor sessions
+    WAKE_MACHINE_WAKE = 1 << 8,          // run the wake action
+    WAKE_MACHINE_START_POLLING = 1 << 9,
+    WAKE_MACHINE_SCHEDULE_ARM = 1 << 10, // fire wake_machine_arm_timer() at arm_deadline
+    WAKE_MACHINE_STANDBY = 1 << 11,      // keep sensors running through suspend
+};
+
+// Sensor readings carry sensorfw's timestamps, input events the monotonic
+// clock evdev is switched to. The two need not share an epoch, so wakes are
+// only ever deduplicated against the last one on the same clock.
+enum wake_machine_clock {
+    WAKE_MACHINE_CLOCK_SENSOR = 0,
+    WAKE_MACHINE_CLOCK_INPUT = 1,
+    WAKE_MACHINE_CLOCKS,
+};
+
+struct wake_machine_config {
+    uint64_t debounce_us; // how long idle has to hold before arming
+    uint64_t dedup_us;    // sensor time within which latches are one motion
+};
+
+struct wake_machine_reading {
+    uint32_t wake;
+    uint64_t wake_timestamp;
+    uint32_t tilt;
+    uint64_t tilt_timestamp;
+};
+
+struct wake_machine {
+    struct wake_machine_config config;
+    enum wake_machine_state state;
+    int idle;
+    int screen_off;
+    int wake_enabled;
+    int tilt_enabled;
+    int listening;
+    int prepared; // sessions acquired ahead of the arm and still unused
+
+    uint64_t arm_deadline;
+    uint64_t wake_latched_at;
+    uint64_t tilt_latched_at;
+    uint64_t last_wake_event[WAKE_MACHINE_CLOCKS];
+    uint64_t vetoed_wake_event[WAKE_MACHINE_CLOCKS]; // last_wake_event before the wake a veto undoes
+
+    // Sessions are acquired at most once per arm, cycles after a wake
+    // included, which is what keeps flapping inputs cheap
+    uint32_t acquisitions;
+};
+
+void wake_machine_init(struct wake_machine *wm, const struct wake_machine_config *config);
+
+unsigned int wake_machine_idle(struct wake_machine *wm, int idle, uint64_t now);
+unsigned int wake_machine_arm_timer(struct wake_machine *wm, uint64_t now);
+unsigned int wake_machine_blank(struct wake_machine *wm);
+unsigned int wake_machine_prepare(struct wake_machine *wm);
+void wake_machine_acquire_failed(struct wake_machine *wm);
+void wake_machine_sessions_lost(struct wake_machine *wm);
+unsigned int wake_machine_settings(struct wake_machine *wm, int wake_enabled, int tilt_enabled,
+                                   int listening, uint64_t now);
+unsigned int wake_machine_screen(struct wake_machine *wm, int on);
+unsigned int wake_machine_reading(struct wake_machine *wm, const struct wake_machine_reading *reading);
+unsigned int wake_machine_blocked(struct wake_machine *wm, unsigned int actions);
+unsigned int wake_machine_input(struct wake_machine *wm, uint64_t timestamp);
+unsigned int wake_machine_sleep(struct wake_machine *wm, int sleeping);
+
+int wake_machine_polls_wake(const struct wake_machine *wm);
+int wake_machine_polls_tilt(const struct wake_machine *wm);
+
+#endif // WAKE_MACHINE_H
@@ -0,0 +1,22 @@
+// SPDX-License-Identifier: MIT
+// Copyright (C) 2026 Bardia Moshiri <bardia@furilabs.com>
+
+#include <batman/wlrdisplay.h>
+#include "wake-module.h"
+
+static gboolean
+screen_on(void)
+{
+    return wlrdisplay(0, NULL) == 0;
+}
+
+// Looked up by name once the daemon has loaded the module
+const WakeModule gesture_sensors_wake_module = {
+    .init = wake_action_init,
+    .clear = wake_action_clear,
+    .set_session = wake_action_set_session,
+    .set_backend = wake_action_set_backend,
+    .run = wake_action_run,
+    .confirm = wake_action_confirm,
+    .screen_on = screen_on,
+};
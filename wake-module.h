@@ -0,0 +1,32 @@
+// SPDX-License-Identifier: MIT
+// Copyright (C) 2026 Bardia Moshiri <bardia@furilabs.com>
+
+#ifndef WAKE_MODULE_H
+#define WAKE_MODULE_H
+
+#include <glib.h>
+#include <gio/gio.h>
+#include "wake-action.h"
+
+// The Wayland, xkbcommon and batman stack behind waking the screen and
+// reading its state lives in a module so sysfs-only setups never map it.
+// WakeAction stays in the daemon's struct, only its code moves.
+#define WAKE_MODULE_NAME "gesture-sensors-wake.so"
+#define WAKE_MODULE_SYMBOL "gesture_sensors_wake_module"
+#define WAKE_MODULE_PATH_ENV "GESTURE_SENSORS_WAKE_MODULE"
+
+#ifndef WAKE_MODULE_DIR
+#define WAKE_MODULE_DIR "/usr/lib/gesture-sensors"
+#endif
+
+typedef struct {
+    void (*init)(WakeAction *wa, GDBusConnection *dbus_connection);
+    void (*clear)(WakeAction *wa);
+    void (*set_session)(WakeAction *wa, const gchar *session_id);
+    gboolean (*set_backend)(WakeAction *wa, const gchar *name);
+    gboolean (*run)(WakeAction *wa, gboolean can_confirm);
+    void (*confirm)(WakeAction *wa);
+    gboolean (*screen_on)(void);
+} WakeModule;
+
+#endif // WAKE_MODULE_H
@@ -0,0 +1,126 @@
+// SPDX-License-Identifier: MIT
+// Copyright (C) 2026 Bardia Moshiri <bardia@furilabs.com>
+
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include "wake-resident.h"
+
+// Mapped files the wake path runs through besides the daemon itself: the
+// wake module, the virtual keyboard and output power backends, and the
+// screen state check
+static const gchar *const wake_libraries[] = {
+    "gesture-sensors-wake.so",
+    "libwayland-client.so",
+    "libxkbcommon.so",
+    "libbatman-wrappers.so",
+};
+
+void
+wake_resident_init(WakeResident *res)
+{
+    memset(res, 0, sizeof(*res));
+}
+
+// mlock() faults the range in before it returns, so a successful lock is
+// also the prefault
+static gboolean
+lock_range(WakeResident *res, gconstpointer start, gsize length)
+{
+    if (res->error || res->n_locked == WAKE_RESIDENT_MAX_RANGES || res->locked_bytes >= res->cap)
+        return FALSE;
+
+    length = MIN(length, res->cap - res->locked_bytes);
+    if (mlock(start, length) < 0) {
+        res->error = errno;
+        return FALSE;
+    }
+
+    res->locked[res->n_locked].start = start;
+    res->locked[res->n_locked].length = length;
+    res->n_locked++;
+    res->locked_bytes += length;
+
+    return TRUE;
+}
+
+static gboolean
+is_wake_mapping(const gchar *path, const gchar *exe)
+{
+    if (g_strcmp0(path, exe) == 0)
+        return TRUE;
+
+    const gchar *name = strrchr(path, '/');
+    name = name ? name + 1 : path;
+
+    for (gsize i = 0; i < G_N_ELEMENTS(wake_libraries); i++)
+        if (g_str_has_prefix(name, wake_libraries[i]))
+            return TRUE;
+
+    return FALSE;
+}
+
+// Buffers come first since they are small and touched on every wake, then
+// the file mappings in address order until the cap is reached. Returns the
+// number of bytes locked.
+gsize
+wake_resident_lock(WakeResident *res, const WakeResidentRange *buffers, guint n_buffers)
+{
+    gchar line[512];
+    gchar path[256];
+    gchar perms[5];
+    gchar *exe;
+    FILE *maps;
+
+    if (res->cap == 0 || res->n_locked > 0)
+        return res->locked_bytes;
+
+    res->error = 0;
+
+    for (guint i = 0; i < n_buffers; i++)
+        if (buffers[i].start && buffers[i].length > 0)
+            lock_range(res, buffers[i].start, buffers[i].length);
+
+    exe = g_file_read_link("/proc/self/exe", NULL);
+    maps = fopen("/proc/self/maps", "r");
+    if (!maps) {
+        g_free(exe);
+        return res->locked_bytes;
+    }
+
+    while (fgets(line, sizeof(line), maps)) {
+        unsigned long start, end;
+
+        path[0] = '\0';
+        if (sscanf(line, "%lx-%lx %4s %*s %*s %*s %255s", &start, &end, perms, path) < 3)
+            continue;
+        if (perms[0] != 'r' || !is_wake_mapping(path, exe))
+            continue;
+        if (!lock_range(res, GSIZE_TO_POINTER(start), end - start) && res->error)
+            break;
+    }
+
+    fclose(maps);
+    g_free(exe);
+
+    // RLIMIT_MEMLOCK is often far below the cap, say so once
+    if (res->error && !res->warned) {
+        g_warning("Wake path only partly resident (%zu KiB): %s", res->locked_bytes / 1024,
+                  g_strerror(res->error));
+        res->warned = TRUE;
+    }
+
+    return res->locked_bytes;
+}
+
+void
+wake_resident_unlock(WakeResident *res)
+{
+    for (guint i = 0; i < res->n_locked; i++)
+        munlock(res->locked[i].start, res->locked[i].length);
+
+    res->n_locked = 0;
+    res->locked_bytes = 0;
+}
@@ -0,0 +1,29 @@
+// SPDX-License-Identifier: MIT
+// Copyright (C) 2026 Bardia Moshiri <bardia@furilabs.com>
+
+#ifndef WAKE_RESIDENT_H
+#define WAKE_RESIDENT_H
+
+#include <glib.h>
+
+#define WAKE_RESIDENT_MAX_RANGES 64
+
+typedef struct {
+    gconstpointer start;
+    gsize length;
+} WakeResidentRange;
+
+typedef struct {
+    gsize cap; // bytes, 0 disables locking
+    WakeResidentRange locked[WAKE_RESIDENT_MAX_RANGES];
+    guint n_locked;
+    gsize locked_bytes;
+    gint error; // errno of the first refused range, 0 when all fit
+    gboolean warned;
+} WakeResident;
+
+void wake_resident_init(WakeResident *res);
+gsize wake_resident_lock(WakeResident *res, const WakeResidentRange *buffers, guint n_buffers);
+void wake_resident_unlock(WakeResident *res);
+
+#endif // WAKE_RESIDENT_H
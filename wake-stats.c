@@ -0,0 +1,180 @@
+// SPDX-License-Identifier: MIT
+// Copyright (C) 2026 Bardia Moshiri <bardia@furilabs.com>
+
+#include <string.h>
+#include "wake-stats.h"
+
+static const gchar *const source_names[WAKE_SOURCE_COUNT] = {
+    [WAKE_SOURCE_WAKE] = "wake",
+    [WAKE_SOURCE_TILT] = "tilt",
+    [WAKE_SOURCE_INPUT] = "input",
+};
+
+const gchar *
+wake_source_name(WakeSource source)
+{
+    return source < WAKE_SOURCE_COUNT ? source_names[source] : "unknown";
+}
+
+// Counters live in XDG_RUNTIME_DIR so they survive the daemon exiting when
+// unused but not a reboot, which also keeps monotonic times in them valid
+static void
+load(WakeStats *stats)
+{
+    GKeyFile *file = g_key_file_new();
+
+    if (!g_key_file_load_from_file(file, stats->path, G_KEY_FILE_NONE, NULL)) {
+        g_key_file_free(file);
+        return;
+    }
+
+    for (WakeSource source = 0; source < WAKE_SOURCE_COUNT; source++) {
+        WakeSourceStats *counts = &stats->sources[source];
+        const gchar *group = source_names[source];
+
+        counts->wakes = g_key_file_get_integer(file, group, "wakes", NULL);
+        counts->false_wakes = g_key_file_get_integer(file, group, "false-wakes", NULL);
+        counts->consecutive_false = g_key_file_get_integer(file, group, "consecutive-false-wakes", NULL);
+    }
+
+    stats->tilt_paused_until = g_key_file_get_int64(file, "policy", "tilt-paused-until", NULL);
+    stats->tilt_pause_level = g_key_file_get_integer(file, "policy", "tilt-pause-level", NULL);
+
+    g_key_file_free(file);
+}
+
+// Written once per classified wake, readable with cat for inspection
+static void
+save(WakeStats *stats)
+{
+    GKeyFile *file = g_key_file_new();
+    GError *error = NULL;
+
+    for (WakeSource source = 0; source < WAKE_SOURCE_COUNT; source++) {
+        WakeSourceStats *counts = &stats->sources[source];
+        const gchar *group = source_names[source];
+
+        g_key_file_set_integer(file, group, "wakes", counts->wakes);
+        g_key_file_set_integer(file, group, "false-wakes", counts->false_wakes);
+        g_key_file_set_integer(file, group, "consecutive-false-wakes", counts->consecutive_false);
+    }
+
+    g_key_file_set_int64(file, "policy", "tilt-paused-until", stats->tilt_paused_until);
+    g_key_file_set_integer(file, "policy", "tilt-pause-level", stats->tilt_pause_level);
+
+    if (!g_key_file_save_to_file(file, stats->path, &error)) {
+        g_debug("Failed to save wake stats: %s", error->message);
+        g_error_free(error);
+    }
+
+    g_key_file_free(file);
+}
+
+void
+wake_stats_init(WakeStats *stats)
+{
+    memset(stats, 0, sizeof(*stats));
+    stats->path = g_build_filename(g_get_user_runtime_dir(), WAKE_STATS_FILE_NAME, NULL);
+    load(stats);
+}
+
+void
+wake_stats_clear(WakeStats *stats)
+{
+    g_free(stats->path);
+    memset(stats, 0, sizeof(*stats));
+}
+
+// A newer wake replaces one that was never classified
+void
+wake_stats_woke(WakeStats *stats, guint sources, gint64 now)
+{
+    stats->pending_at = now;
+    stats->pending_sources = sources;
+}
+
+static guint
+pause_tilt(WakeStats *stats, gint64 now)
+{
+    guint pause_s = WAKE_STATS_PAUSE_MIN_S;
+
+    for (guint level = 0; level < stats->tilt_pause_level && pause_s < WAKE_STATS_PAUSE_MAX_S; level++)
+        pause_s *= 2;
+    pause_s = MIN(pause_s, WAKE_STATS_PAUSE_MAX_S);
+
+    stats->tilt_paused_until = now + (gint64)pause_s * G_USEC_PER_SEC;
+    stats->tilt_pause_level++;
+    stats->sources[WAKE_SOURCE_TILT].consecutive_false = 0;
+
+    return pause_s;
+}
+
+// limit consecutive false tilt wakes pause tilt wake, 0 only counts. A
+// wanted tilt wake resets the backoff.
+static void
+classify(WakeStats *stats, gint64 now, gboolean false_wake, guint limit, WakeOutcome *outcome)
+{
+    outcome->sources = stats->pending_sources;
+    outcome->false_wake = false_wake;
+    outcome->tilt_pause_s = 0;
+
+    for (WakeSource source = 0; source < WAKE_SOURCE_COUNT; source++) {
+        WakeSourceStats *counts = &stats->sources[source];
+
+        if (!(outcome->sources & WAKE_SOURCE_BIT(source)))
+            continue;
+
+        counts->wakes++;
+        if (outcome->false_wake) {
+            counts->false_wakes++;
+            counts->consecutive_false++;
+        } else {
+            counts->consecutive_false = 0;
+        }
+    }
+
+    if (outcome->sources & WAKE_SOURCE_BIT(WAKE_SOURCE_TILT)) {
+        if (!outcome->false_wake)
+            stats->tilt_pause_level = 0;
+        else if (limit > 0 && stats->sources[WAKE_SOURCE_TILT].consecutive_false >= limit)
+            outcome->tilt_pause_s = pause_tilt(stats, now);
+    }
+
+    stats->pending_at = 0;
+    stats->pending_sources = 0;
+    save(stats);
+}
+
+// Called when the user shows up after a wake. Activity within grace_us of
+// the wake is taken to be the wake action's own and ignored.
+gboolean
+wake_stats_activity(WakeStats *stats, gint64 now, gint64 grace_us, guint limit,
+                    WakeOutcome *outcome)
+{
+    if (!stats->pending_at || now - stats->pending_at < grace_us)
+        return FALSE;
+
+    classify(stats, now, FALSE, limit, outcome);
+    return TRUE;
+}
+
+// Called when the screen goes off or the session idle again. A wake still
+// pending then saw no activity, and counts as false when this comes within
+// window_us of it. Later than that someone was likely reading the screen.
+gboolean
+wake_stats_settle(WakeStats *stats, gint64 now, gint64 window_us, guint limit,
+                  WakeOutcome *outcome)
+{
+    if (!stats->pending_at || window_us <= 0)
+        return FALSE;
+
+    classify(stats, now, now - stats->pending_at < window_us, limit, outcome);
+    return TRUE;
+}
+
+// Remaining pause in us, 0 when tilt may wake
+gint64
+wake_stats_tilt_paused_for(WakeStats *stats, gint64 now)
+{
+    return stats->tilt_paused_until > now ? stats->tilt_paused_until - now : 0;
+}
@@ -0,0 +1,56 @@
+// SPDX-License-Identifier: MIT
+// Copyright (C) 2026 Bardia Moshiri <bardia@furilabs.com>
+
+#ifndef WAKE_STATS_H
+#define WAKE_STATS_H
+
+#include <glib.h>
+
+#define WAKE_STATS_FILE_NAME "gesture-sensors-wakes"
+
+// A tilt pause starts at 15 minutes and doubles each time it trips again,
+// up to 4 hours
+#define WAKE_STATS_PAUSE_MIN_S 900
+#define WAKE_STATS_PAUSE_MAX_S 14400
+
+typedef enum {
+    WAKE_SOURCE_WAKE = 0,
+    WAKE_SOURCE_TILT,
+    WAKE_SOURCE_INPUT,
+    WAKE_SOURCE_COUNT,
+} WakeSource;
+
+#define WAKE_SOURCE_BIT(source) (1u << (source))
+
+typedef struct {
+    guint wakes;
+    guint false_wakes;
+    guint consecutive_false;
+} WakeSourceStats;
+
+typedef struct {
+    guint sources;      // WAKE_SOURCE_BIT() of what caused the wake
+    gboolean false_wake;
+    guint tilt_pause_s; // tilt pause started by this outcome, 0 for none
+} WakeOutcome;
+
+typedef struct {
+    gchar *path;
+    WakeSourceStats sources[WAKE_SOURCE_COUNT];
+    gint64 pending_at; // monotonic time of the unclassified wake, 0 for none
+    guint pending_sources;
+    gint64 tilt_paused_until;
+    guint tilt_pause_level;
+} WakeStats;
+
+void wake_stats_init(WakeStats *stats);
+void wake_stats_clear(WakeStats *stats);
+void wake_stats_woke(WakeStats *stats, guint sources, gint64 now);
+gboolean wake_stats_activity(WakeStats *stats, gint64 now, gint64 grace_us, guint limit,
+                             WakeOutcome *outcome);
+gboolean wake_stats_settle(WakeStats *stats, gint64 now, gint64 window_us, guint limit,
+                           WakeOutcome *outcome);
+gint64 wake_stats_tilt_paused_for(WakeStats *stats, gint64 now);
+const gchar *wake_source_name(WakeSource source);
+
+#endif // WAKE_STATS_H